@@ -0,0 +1,314 @@
+// BatchAnalyzer.cpp
+#include "BatchAnalyzer.h"
+#include "MappedFile.h"
+#include "ContentHash.h"
+#include "PersistenceQueue.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+BatchAnalyzer::BatchAnalyzer(unsigned threads, bool store, size_t writeBatch, const string &spec)
+    : threadCount(threads), storeResults(store), writeBatchRows(min(max<size_t>(writeBatch, 1), BulkWriter::MAX_BATCH_ROWS)), storeSpec(spec) {
+    if (threadCount == 0) {
+        threadCount = max(1u, thread::hardware_concurrency());
+    }
+}
+
+vector<string> BatchAnalyzer::discoverFiles(const string &directory) const {
+    vector<string> files;
+    error_code ec;
+    for (fs::recursive_directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->is_regular_file(ec)) {
+            files.push_back(it->path().string());
+        }
+    }
+    if (ec) {
+        cerr << "[BatchAnalyzer] Error reading " << directory << ": " << ec.message() << endl;
+    }
+    sort(files.begin(), files.end());
+    return files;
+}
+
+FileOutcome BatchAnalyzer::processFile(const string &path, const KeywordMatcher &matcher,
+                                       PolicyStore &db, PersistenceQueue &queue, BatchStats &stats) {
+    // Shared with the queued row, which writes straight from the mapping
+    shared_ptr<MappedFile> file = make_shared<MappedFile>();
+    if (!file->open(path)) {
+        return FILE_FAILED;
+    }
+
+    string_view text = file->view();
+    if (text.empty()) {
+        cerr << "[BatchAnalyzer] Skipping empty file: " << path << endl;
+        return FILE_FAILED;
+    }
+
+    // Unchanged policies from earlier runs need neither matching nor storing
+    uint64_t hash = contentHash(text);
+    if (storeResults && (!firstSighting(hash, text.size()) || db.findPolicyByHash(hash, text.size()) >= 0)) {
+        return FILE_DUPLICATE;
+    }
+
+    // Counts are enough for the report; skip per-hit offsets
+    stats.bytes += text.size();
+    MatchResult result = matcher.match(text, false);
+    for (size_t count : result.keywordCounts) {
+        stats.keywordHits += count;
+    }
+
+    if (!storeResults) {
+        return FILE_ANALYZED;
+    }
+
+    // Written behind by the queue's writer thread; failures are counted at the end
+    PolicyWrite row;
+    row.contentView = text;
+    row.contentOwner = file;
+    row.source = "file";
+    row.filename = path;
+    row.hash = hash;
+    row.keyword_analysis = matcher.formatAnalysis(result);
+    row.counts = matcher.analysisCounts(result);
+    return queue.enqueuePolicy(move(row)) >= 0 ? FILE_ANALYZED : FILE_FAILED;
+}
+
+static void printSummary(const char *title, const BatchStats &stats) {
+    double seconds = max(stats.seconds, 1e-9);
+    double megabytes = stats.bytes / (1024.0 * 1024.0);
+    cout << fixed << setprecision(2);
+    cout << "\n " << title << "\n";
+    cout << "------------------------------------\n";
+    cout << "Documents analyzed: " << stats.documents << "\n";
+    cout << "Already stored:     " << stats.duplicates << "\n";
+    cout << "Documents failed:   " << stats.failed << "\n";
+    cout << "Data processed:     " << megabytes << " MB\n";
+    cout << "Keyword hits:       " << stats.keywordHits << "\n";
+    cout << "Elapsed:            " << stats.seconds << " s\n";
+    cout << "Throughput:         " << stats.documents / seconds << " docs/s, "
+         << megabytes / seconds << " MB/s\n";
+    cout << defaultfloat;
+}
+
+static void addStats(BatchStats &into, const BatchStats &from) {
+    into.documents += from.documents;
+    into.failed += from.failed;
+    into.duplicates += from.duplicates;
+    into.bytes += from.bytes;
+    into.keywordHits += from.keywordHits;
+}
+
+bool BatchAnalyzer::firstSighting(uint64_t hash, size_t size) {
+    // Copies still waiting in some writer's batch are not in the DB yet
+    lock_guard<mutex> lock(seenMutex);
+    return seenContent.insert(make_pair(hash, size)).second;
+}
+
+BatchStats BatchAnalyzer::run(const string &directory) {
+    BatchStats stats;
+
+    vector<string> files = discoverFiles(directory);
+    if (files.empty()) {
+        cerr << "[BatchAnalyzer] No policy files found in " << directory << endl;
+        return stats;
+    }
+
+    // One keyword set shared read-only by all workers; each document is
+    // matched on a single thread since the pool already uses every core
+    unique_ptr<PolicyStore> store = openStore(storeSpec);
+    KeywordMatcher matcher;
+    matcher.setQuiet(true);
+    matcher.setMatchThreads(1);
+    if (!store || !store->migrateSchema()) {
+        cerr << "[BatchAnalyzer] Could not prepare the database schema"
+             << (store ? ": " + store->getLastError() : "") << endl;
+        stats.failed = files.size();
+        return stats;
+    }
+    if (!matcher.loadKeywords(*store)) {
+        cerr << "[BatchAnalyzer] Could not load keywords from DB.\n";
+        stats.failed = files.size();
+        return stats;
+    }
+
+    unsigned workers = (unsigned)min<size_t>(threadCount, files.size());
+    cout << "[BatchAnalyzer] Analyzing " << files.size() << " files with "
+         << workers << " worker(s)...\n";
+
+    // Workers only match; one writer thread stores their results in batches,
+    // and a full queue slows the workers down instead of growing memory
+    PersistenceQueue queue(storeSpec, writeBatchRows);
+    atomic<size_t> nextFile(0);
+    mutex statsMutex;
+    auto start = chrono::steady_clock::now();
+
+    auto worker = [&]() {
+        // Per-worker store (own lastError); MySQL connections come from the
+        // process-wide pool, which caps how many are open at once
+        unique_ptr<PolicyStore> db = openStore(storeSpec);
+        db->threadInit();
+
+        BatchStats local;
+        for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+            switch (processFile(files[i], matcher, *db, queue, local)) {
+                case FILE_ANALYZED:
+                    local.documents++;
+                    break;
+                case FILE_DUPLICATE:
+                    local.duplicates++;
+                    break;
+                case FILE_FAILED:
+                    local.failed++;
+                    break;
+            }
+        }
+        db->threadEnd();
+        db.reset();
+
+        lock_guard<mutex> lock(statsMutex);
+        addStats(stats, local);
+    };
+
+    vector<thread> pool;
+    for (unsigned t = 0; t < workers; t++) {
+        pool.emplace_back(worker);
+    }
+    for (auto &t : pool) {
+        t.join();
+    }
+
+    // Everything analyzed must be in the database before reporting
+    queue.shutdown();
+    size_t lost = queue.failedJobs();
+    stats.documents -= lost;
+    stats.failed += lost;
+
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printSummary("Batch Analysis Summary", stats);
+    return stats;
+}
+
+void BatchAnalyzer::reanalyzePolicy(const PolicyRecord &policy, const KeywordMatcher &matcher,
+                                    PersistenceQueue &queue, BatchStats &stats) {
+    if (policy.content.empty()) {
+        stats.failed++;
+        return;
+    }
+    stats.bytes += policy.content.size();
+
+    MatchResult result = matcher.match(policy.content, false);
+    for (size_t count : result.keywordCounts) {
+        stats.keywordHits += count;
+    }
+    if (storeResults
+        && !queue.enqueueAnalysis(policy.id, matcher.formatAnalysis(result), "", matcher.analysisCounts(result))) {
+        stats.failed++;
+        return;
+    }
+    stats.documents++;
+}
+
+BatchStats BatchAnalyzer::reanalyzeStored() {
+    BatchStats stats;
+
+    unique_ptr<PolicyStore> store = openStore(storeSpec);
+    KeywordMatcher matcher;
+    matcher.setQuiet(true);
+    matcher.setMatchThreads(1);
+    if (!store || !store->migrateSchema()) {
+        cerr << "[BatchAnalyzer] Could not prepare the database schema"
+             << (store ? ": " + store->getLastError() : "") << endl;
+        stats.failed = 1;
+        return stats;
+    }
+    if (!matcher.loadKeywords(*store)) {
+        cerr << "[BatchAnalyzer] Could not load keywords from DB.\n";
+        stats.failed = 1;
+        return stats;
+    }
+
+    cout << "[BatchAnalyzer] Re-analyzing stored policies with " << threadCount << " worker(s)...\n";
+
+    // This thread reads batches of policies and hands them to the workers,
+    // waiting while two batches per worker are still untouched; the
+    // workers' analyses are written behind them by the queue in batches
+    PersistenceQueue queue(storeSpec, writeBatchRows);
+    mutex workMutex, statsMutex;
+    condition_variable workReady, roomReady;
+    deque<vector<PolicyRecord>> work;
+    bool readerDone = false;
+    const size_t maxWaiting = 2 * (size_t)threadCount;
+    auto start = chrono::steady_clock::now();
+
+    auto worker = [&]() {
+        BatchStats local;
+        while (true) {
+            vector<PolicyRecord> batch;
+            {
+                unique_lock<mutex> guard(workMutex);
+                workReady.wait(guard, [&]() { return readerDone || !work.empty(); });
+                if (work.empty()) break;
+                batch = move(work.front());
+                work.pop_front();
+            }
+            roomReady.notify_one();
+            for (const auto &policy : batch) {
+                reanalyzePolicy(policy, matcher, queue, local);
+            }
+        }
+
+        lock_guard<mutex> lock(statsMutex);
+        addStats(stats, local);
+    };
+
+    vector<thread> pool;
+    for (unsigned t = 0; t < threadCount; t++) {
+        pool.emplace_back(worker);
+    }
+
+    vector<PolicyRecord> batch;
+    auto handOff = [&]() {
+        unique_lock<mutex> guard(workMutex);
+        roomReady.wait(guard, [&]() { return work.size() < maxWaiting; });
+        work.push_back(move(batch));
+        batch.clear();
+        workReady.notify_one();
+    };
+    bool complete = store->forEachPolicy([&](const PolicyRecord &policy) {
+        batch.push_back(policy);
+        if (batch.size() >= writeBatchRows) handOff();
+        return true;
+    }, (int)writeBatchRows);
+    if (!batch.empty()) handOff();
+
+    {
+        lock_guard<mutex> guard(workMutex);
+        readerDone = true;
+    }
+    workReady.notify_all();
+    for (auto &t : pool) {
+        t.join();
+    }
+
+    if (!complete) {
+        cerr << "[BatchAnalyzer] Reading stored policies failed: " << store->getLastError() << endl;
+        stats.failed++;
+    }
+
+    queue.shutdown();
+    size_t lost = queue.failedJobs();
+    stats.documents -= min(lost, stats.documents);
+    stats.failed += lost;
+
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printSummary("Re-analysis Summary", stats);
+    return stats;
+}
@@ -0,0 +1,76 @@
+// BatchAnalyzer.h
+#ifndef BATCHANALYZER_H
+#define BATCHANALYZER_H
+
+#include "KeywordMatcher.h"
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+class PersistenceQueue;
+
+// Totals for one batch run
+struct BatchStats {
+    size_t documents = 0; // analyzed successfully
+    size_t failed = 0;
+    size_t duplicates = 0; // already stored, skipped before matching
+    size_t bytes = 0;      // of the documents actually matched
+    size_t keywordHits = 0;
+    double seconds = 0.0;
+};
+
+// What became of one file in a batch run
+enum FileOutcome {
+    FILE_ANALYZED,
+    FILE_DUPLICATE,
+    FILE_FAILED
+};
+
+// Non-interactive analysis of every policy file under a directory.
+// Files are mapped, matched against one shared keyword set and stored
+// together with their keyword analysis by a bounded pool of workers that
+// borrow database connections from the shared connection pool. Results go
+// through a write-behind PersistenceQueue, in transactions of writeBatchRows.
+class BatchAnalyzer {
+private:
+    unsigned threadCount;
+    bool storeResults;
+    size_t writeBatchRows;
+    string storeSpec; // see openStore
+    mutex seenMutex;
+    set<pair<uint64_t, size_t>> seenContent; // (hash, size) of every file queued this run
+
+    // Regular files under directory, sorted for a stable processing order
+    vector<string> discoverFiles(const string &directory) const;
+
+    // load -> keyword analysis -> queue for storing, for one file
+    FileOutcome processFile(const string &path, const KeywordMatcher &matcher,
+                            PolicyStore &db, PersistenceQueue &queue, BatchStats &stats);
+
+    // False if a file with this content was already seen in this run
+    bool firstSighting(uint64_t hash, size_t size);
+
+    // Match one stored policy and queue its fresh analysis
+    void reanalyzePolicy(const PolicyRecord &policy, const KeywordMatcher &matcher,
+                         PersistenceQueue &queue, BatchStats &stats);
+
+public:
+    // threads == 0 uses every hardware thread; writeBatch is the number of
+    // policies stored per transaction; spec selects the backend (see openStore)
+    BatchAnalyzer(unsigned threads = 0, bool store = true, size_t writeBatch = 200, const string &spec = "");
+
+    // Analyze every file under directory and print throughput
+    BatchStats run(const string &directory);
+
+    // Match every policy already in the store against the current keywords
+    // and store a fresh analysis for each. Policies are streamed from the
+    // store in batches that a pool of workers matches, a few batches ahead
+    // at most, so memory does not grow with the table.
+    BatchStats reanalyzeStored();
+};
+
+#endif
@@ -0,0 +1,186 @@
+// Benchmark.cpp
+#include "Benchmark.h"
+#include "KeywordMatcher.h"
+#include "ContentHash.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Best of this many timed runs per configuration
+static const int TIMED_RUNS = 3;
+
+// One keyword per this many words on average
+static const unsigned WORDS_PER_KEYWORD = 12;
+
+static const char *FILLER_WORDS[] = {
+    "the", "service", "may", "we", "our", "when", "you", "use", "account", "website",
+    "information", "purposes", "described", "below", "in", "order", "to", "provide",
+    "and", "improve", "features", "such", "as", "settings", "for", "with", "this", "policy"
+};
+
+// Size of each policy stored by the insert benchmark
+static const size_t INSERT_POLICY_BYTES = 4 * 1024;
+
+// Reproducible policy-like text of at least bytes characters
+static string generateCorpus(const vector<string> &keywords, size_t bytes, unsigned seed = 42) {
+    mt19937 random(seed);
+    const size_t fillerCount = sizeof(FILLER_WORDS) / sizeof(FILLER_WORDS[0]);
+    string text;
+    text.reserve(bytes + 256);
+    unsigned wordsInSentence = 0;
+    while (text.size() < bytes) {
+        if (!keywords.empty() && random() % WORDS_PER_KEYWORD == 0) {
+            text += keywords[random() % keywords.size()];
+        } else {
+            text += FILLER_WORDS[random() % fillerCount];
+        }
+        if (++wordsInSentence == 18) {
+            text += ".\n";
+            wordsInSentence = 0;
+        } else {
+            text += ' ';
+        }
+    }
+    return text;
+}
+
+static size_t totalHits(const MatchResult &result) {
+    size_t hits = 0;
+    for (size_t count : result.keywordCounts) {
+        hits += count;
+    }
+    return hits;
+}
+
+int runScanBenchmark(const string &storeSpec, size_t megabytes, unsigned maxThreads) {
+    unique_ptr<PolicyStore> store = openStore(storeSpec);
+    KeywordMatcher matcher;
+    matcher.setQuiet(true);
+    if (!store || !store->migrateSchema() || !matcher.loadKeywords(*store)) {
+        cerr << "[Benchmark] Could not load keywords"
+             << (store ? ": " + store->getLastError() : "") << endl;
+        return 1;
+    }
+    if (maxThreads == 0) {
+        maxThreads = max(1u, thread::hardware_concurrency());
+    }
+
+    string text = generateCorpus(matcher.getKeywordNames(), megabytes * 1024 * 1024);
+    double size = text.size() / (1024.0 * 1024.0);
+    cout << "[Benchmark] Scanning " << fixed << setprecision(1) << size << " MB for "
+         << matcher.getKeywordNames().size() << " keywords, best of " << TIMED_RUNS << " runs ("
+         << thread::hardware_concurrency() << " hardware threads)\n\n";
+
+    vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    cout << right << setw(8) << "Threads" << setw(12) << "Seconds" << setw(12) << "MB/s"
+         << setw(10) << "Speedup" << setw(12) << "Hits" << "\n";
+    double serialSeconds = 0.0;
+    size_t serialHits = 0;
+    bool consistent = true;
+    for (unsigned threads : threadCounts) {
+        matcher.setMatchThreads(threads);
+        double best = 0.0;
+        size_t hits = 0;
+        for (int run = 0; run < TIMED_RUNS; run++) {
+            auto start = chrono::steady_clock::now();
+            MatchResult result = matcher.match(text, false);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            hits = totalHits(result);
+            if (run == 0 || seconds < best) best = seconds;
+        }
+        if (threads == 1) {
+            serialSeconds = best;
+            serialHits = hits;
+        }
+        // Every split of the text must find exactly what the serial scan finds
+        consistent = consistent && hits == serialHits;
+
+        cout << setw(8) << threads << setprecision(3) << setw(12) << best
+             << setprecision(1) << setw(12) << size / max(best, 1e-9)
+             << setprecision(2) << setw(9) << serialSeconds / max(best, 1e-9) << "x"
+             << setw(12) << hits << "\n";
+    }
+    cout << defaultfloat;
+
+    if (!consistent) {
+        cerr << "[Benchmark] Parallel scans disagree with the serial scan on the hit count.\n";
+        return 1;
+    }
+    return 0;
+}
+
+int runInsertBenchmark(const string &storeSpec, size_t rows, size_t batchRows) {
+    unique_ptr<PolicyStore> store = openStore(storeSpec);
+    KeywordMatcher matcher;
+    matcher.setQuiet(true);
+    if (!store || !store->migrateSchema() || !matcher.loadKeywords(*store)) {
+        cerr << "[Benchmark] Could not prepare the store"
+             << (store ? ": " + store->getLastError() : "") << endl;
+        return 1;
+    }
+    batchRows = max<size_t>(1, min(batchRows, rows));
+
+    struct Mode {
+        const char *name;
+        size_t batch;
+        bool multiRow;
+    };
+    const Mode modes[] = {
+        {"1 row per batch", 1, false},
+        {"single-row INSERTs", batchRows, false},
+        {"multi-row INSERTs", batchRows, true},
+    };
+
+    cout << "[Benchmark] Storing " << rows << " policies of " << INSERT_POLICY_BYTES / 1024
+         << " KB with an analysis each, " << batchRows << " per batch\n\n";
+    cout << left << setw(22) << "Mode" << right << setw(10) << "Seconds" << setw(12) << "docs/s"
+         << setw(10) << "MB/s" << "\n";
+
+    unsigned seed = 1;
+    for (const Mode &mode : modes) {
+        // Generated up front so only the inserts are timed; every policy is
+        // distinct, so no run finds another's rows
+        vector<PolicyWrite> writes(rows);
+        size_t bytes = 0;
+        for (PolicyWrite &row : writes) {
+            row.content = generateCorpus(matcher.getKeywordNames(), INSERT_POLICY_BYTES, seed++);
+            row.source = "benchmark";
+            row.hash = contentHash(row.content);
+            MatchResult result = matcher.match(row.content, false);
+            row.keyword_analysis = matcher.formatAnalysis(result);
+            row.counts = matcher.analysisCounts(result);
+            bytes += row.content.size();
+        }
+
+        store->setMultiRowInserts(mode.multiRow);
+        auto start = chrono::steady_clock::now();
+        vector<int> ids;
+        for (size_t first = 0; first < rows; first += mode.batch) {
+            vector<PolicyWrite> batch(make_move_iterator(writes.begin() + first),
+                                      make_move_iterator(writes.begin() + min(rows, first + mode.batch)));
+            if (!store->storePolicyBatch(batch, ids)) {
+                cerr << "[Benchmark] Insert failed: " << store->getLastError() << endl;
+                return 1;
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        seconds = max(seconds, 1e-9);
+
+        cout << left << setw(22) << mode.name << right << fixed << setprecision(3) << setw(10) << seconds
+             << setprecision(1) << setw(12) << rows / seconds
+             << setprecision(2) << setw(10) << bytes / (1024.0 * 1024.0) / seconds << "\n";
+    }
+    cout << defaultfloat;
+    store->setMultiRowInserts(true);
+    return 0;
+}
@@ -0,0 +1,21 @@
+// Benchmark.h
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+
+using namespace std;
+
+// Time the keyword scan of one generated document of megabytes MB with
+// 1, 2, 4, ... up to maxThreads match threads (0 = all cores) and print the
+// throughput and speedup of each. Keywords come from the store; the text
+// mixes them into filler words, so the hit density resembles a policy.
+int runScanBenchmark(const string &storeSpec, size_t megabytes, unsigned maxThreads);
+
+// Store rows generated policies with an analysis each, three ways: one
+// row per storePolicyBatch call, batches of batchRows sent as one INSERT
+// per row, and the same batches as multi-row INSERTs. Prints docs/s for
+// each. The rows stay in the store, so point it at a scratch database.
+int runInsertBenchmark(const string &storeSpec, size_t rows, size_t batchRows);
+
+#endif
@@ -0,0 +1,169 @@
+// BulkWriter.cpp
+#include "BulkWriter.h"
+#include "ContentHash.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+BulkWriter::BulkWriter(PolicyStore &database, size_t rows,
+                       chrono::milliseconds interval, size_t maxBytes)
+    : db(database), batchRows(min(max<size_t>(rows, 1), MAX_BATCH_ROWS)), maxBatchBytes(maxBytes),
+      flushInterval(interval), firstPending(0), pendingBytes(0),
+      lastFlush(chrono::steady_clock::now()), retries(0), retryDelay(100), failed(0) {
+}
+
+BulkWriter::~BulkWriter() {
+    flush();
+}
+
+bool BulkWriter::add(PolicyWrite row) {
+    pendingBytes += row.text().size();
+    pending.push_back(move(row));
+
+    if (pending.size() >= batchRows || pendingBytes >= maxBatchBytes
+        || chrono::steady_clock::now() - lastFlush >= flushInterval) {
+        return flush();
+    }
+    return true;
+}
+
+bool BulkWriter::addAnalysisOf(size_t policyRow, PolicyWrite analysis) {
+    if (!isPending(policyRow)) return false;
+    analysis.policy_id = -1;
+    analysis.policy_row = (int)(policyRow - firstPending);
+    return add(move(analysis));
+}
+
+size_t BulkWriter::nextRow() const {
+    return firstPending + pending.size();
+}
+
+bool BulkWriter::isPending(size_t row) const {
+    return row >= firstPending && row < nextRow();
+}
+
+bool BulkWriter::flush() {
+    lastFlush = chrono::steady_clock::now();
+    if (pending.empty()) return true;
+
+    linkStoredCopies();
+
+    // Batches are transactional, so a failed attempt left nothing behind
+    vector<int> ids;
+    bool ok = db.storePolicyBatch(pending, ids);
+    chrono::milliseconds delay = retryDelay;
+    for (unsigned attempt = 1; !ok && attempt <= retries; attempt++) {
+        cerr << "[BulkWriter] Batch failed (" << db.getLastError() << "), retry " << attempt
+             << " of " << retries << " in " << delay.count() << " ms\n";
+        this_thread::sleep_for(delay);
+        delay *= 2;
+        ok = db.storePolicyBatch(pending, ids);
+    }
+    if (!ok && pending.size() > 1) {
+        cerr << "[BulkWriter] Batch of " << pending.size() << " rows failed (" << db.getLastError()
+             << "), storing its policies one at a time\n";
+        ok = writeSeparately(ids);
+    } else if (!ok) {
+        cerr << "[BulkWriter] Batch of " << pending.size() << " rows failed: " << db.getLastError() << endl;
+        ids.assign(pending.size(), -1);
+        failed += pending.size();
+    }
+    for (size_t i = 0; i < pending.size(); i++) {
+        written.push_back(make_pair(firstPending + i, ids[i]));
+    }
+
+    firstPending += pending.size();
+    pending.clear();
+    pendingBytes = 0;
+    return ok;
+}
+
+void BulkWriter::linkStoredCopies() {
+    for (size_t i = 0; i < pending.size(); i++) {
+        PolicyWrite& row = pending[i];
+        if (!row.reuseStored || !row.storesPolicy()) continue;
+
+        string_view text = row.text();
+        if (row.hash == 0) row.hash = contentHash(text);
+
+        // An identical policy earlier in this batch, else one already stored
+        int earlier = -1;
+        for (size_t j = 0; j < i && earlier < 0; j++) {
+            if (pending[j].storesPolicy() && pending[j].hash == row.hash && pending[j].text().size() == text.size()) {
+                earlier = (int)j;
+            }
+        }
+        int stored = earlier < 0 ? db.findPolicyByHash(row.hash, text.size()) : -1;
+        if (earlier < 0 && stored < 0) continue;
+
+        // Becomes an analysis-only row (or nothing at all without one), and
+        // analyses that pointed at it follow it to the copy
+        row.policy_row = earlier;
+        row.policy_id = stored;
+        for (size_t k = i + 1; k < pending.size(); k++) {
+            if (pending[k].policy_row == (int)i) {
+                pending[k].policy_row = earlier;
+                pending[k].policy_id = stored;
+            }
+        }
+        if (stored >= 0) {
+            cout << "[BulkWriter] Identical policy already stored as ID " << stored << ", skipping insert.\n";
+        }
+    }
+}
+
+bool BulkWriter::writeSeparately(vector<int>& ids) {
+    // Each policy goes with the analyses that refer to it by row
+    vector<vector<size_t>> groups;
+    vector<size_t> groupOf(pending.size(), 0);
+    for (size_t i = 0; i < pending.size(); i++) {
+        int owner = pending[i].policy_row;
+        if (owner >= 0 && owner < (int)i) {
+            groupOf[i] = groupOf[owner];
+            groups[groupOf[i]].push_back(i);
+        } else {
+            groupOf[i] = groups.size();
+            groups.push_back({i});
+        }
+    }
+
+    ids.assign(pending.size(), -1);
+    size_t lost = 0;
+    for (const auto& group : groups) {
+        vector<PolicyWrite> rows;
+        for (size_t i : group) {
+            rows.push_back(move(pending[i]));
+            if (rows.size() > 1) rows.back().policy_row = 0;
+        }
+        vector<int> groupIds;
+        if (!db.storePolicyBatch(rows, groupIds)) {
+            cerr << "[BulkWriter] Dropping " << rows.size() << " row(s): " << db.getLastError() << endl;
+            lost += rows.size();
+            continue;
+        }
+        for (size_t n = 0; n < group.size(); n++) {
+            ids[group[n]] = groupIds[n];
+        }
+    }
+    failed += lost;
+    return lost == 0;
+}
+
+void BulkWriter::setRetries(unsigned attempts, chrono::milliseconds firstDelay) {
+    retries = attempts;
+    retryDelay = firstDelay;
+}
+
+size_t BulkWriter::pendingRows() const {
+    return pending.size();
+}
+
+size_t BulkWriter::failedRows() const {
+    return failed;
+}
+
+vector<pair<size_t, int>> BulkWriter::takeWritten() {
+    vector<pair<size_t, int>> taken;
+    taken.swap(written);
+    return taken;
+}
@@ -0,0 +1,86 @@
+// BulkWriter.h
+#ifndef BULKWRITER_H
+#define BULKWRITER_H
+
+#include "PolicyStore.h"
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Accumulates policies with their keyword analyses, and analyses of
+// policies already stored, and writes them with PolicyStore::storePolicyBatch,
+// so ingest pays one transaction per batch instead of two autocommits per
+// document. A batch is written when it reaches batchRows or maxBatchBytes
+// of content, or on the first add() after flushInterval has passed since
+// the last write. Rows are numbered from 0 in add order.
+class BulkWriter {
+private:
+    PolicyStore &db;
+    size_t batchRows;
+    size_t maxBatchBytes;
+    chrono::milliseconds flushInterval;
+    vector<PolicyWrite> pending;
+    size_t firstPending;   // row number of pending[0]
+    size_t pendingBytes;
+    chrono::steady_clock::time_point lastFlush;
+    unsigned retries;                 // extra attempts for a failed batch
+    chrono::milliseconds retryDelay;  // before the first retry, doubling after
+    vector<pair<size_t, int>> written; // (row number, policy id) not yet taken
+    size_t failed;
+
+    // Point rows marked reuseStored at an identical policy stored earlier
+    // or queued earlier in the batch, instead of inserting another copy
+    void linkStoredCopies();
+
+    // After a batch failed for good: store each policy with its analyses,
+    // and each lone analysis, in a transaction of its own, so one bad row
+    // only loses itself. Rows are moved out of pending.
+    bool writeSeparately(vector<int>& ids);
+
+public:
+    // Largest batch whose multi-row policy INSERT (8 placeholders a row)
+    // stays within the 65535 placeholders MySQL allows per statement
+    static constexpr size_t MAX_BATCH_ROWS = 65535 / 8;
+
+    // rows is clamped to [1, MAX_BATCH_ROWS]
+    BulkWriter(PolicyStore &database, size_t rows = 200,
+               chrono::milliseconds interval = chrono::milliseconds(1000),
+               size_t maxBytes = 16 * 1024 * 1024);
+
+    // Writes whatever is still pending
+    ~BulkWriter();
+
+    BulkWriter(const BulkWriter&) = delete;
+    BulkWriter& operator=(const BulkWriter&) = delete;
+
+    // Queue one row; false if a write it triggered failed
+    bool add(PolicyWrite row);
+
+    // Queue an analysis of the policy added as row number policyRow, which
+    // must still be pending (see isPending); it is written in the same batch
+    bool addAnalysisOf(size_t policyRow, PolicyWrite analysis);
+
+    // Number the next add() will give its row
+    size_t nextRow() const;
+
+    // True while row number row waits in the current batch
+    bool isPending(size_t row) const;
+
+    // Write all pending rows now; false if the batch failed
+    bool flush();
+
+    // Retry failed batches, waiting firstDelay and then twice as long each time
+    void setRetries(unsigned attempts, chrono::milliseconds firstDelay);
+
+    size_t pendingRows() const;
+    size_t failedRows() const;
+
+    // (row number, policy id) of every row written since the last call, in
+    // add order; the id is -1 for rows whose batch failed
+    vector<pair<size_t, int>> takeWritten();
+};
+
+#endif
@@ -0,0 +1,224 @@
+// ConnectionPool.cpp
+#include "ConnectionPool.h"
+#include <iostream>
+#include <map>
+
+// Bulk inserts prepare one statement per row count; past this many, new
+// statements only live until the connection is returned
+static const size_t MAX_CACHED_STATEMENTS = 64;
+
+PooledConnection::PooledConnection() : broken(false) {
+}
+
+PooledConnection::PooledConnection(shared_ptr<ConnectionPool> owner, unique_ptr<PoolEntry> checkedOut)
+    : pool(move(owner)), entry(move(checkedOut)), broken(false) {
+}
+
+PooledConnection::PooledConnection(PooledConnection&& other) noexcept
+    : pool(move(other.pool)), entry(move(other.entry)), transient(move(other.transient)),
+      broken(other.broken) {
+}
+
+PooledConnection& PooledConnection::operator=(PooledConnection&& other) noexcept {
+    if (this != &other) {
+        transient.clear();
+        if (pool && entry) {
+            pool->release(move(entry), !broken);
+        }
+        pool = move(other.pool);
+        entry = move(other.entry);
+        transient = move(other.transient);
+        broken = other.broken;
+    }
+    return *this;
+}
+
+PooledConnection::~PooledConnection() {
+    transient.clear();
+    if (pool && entry) {
+        pool->release(move(entry), !broken);
+    }
+}
+
+sql::Connection* PooledConnection::operator->() const {
+    return entry->connection.get();
+}
+
+sql::Connection& PooledConnection::operator*() const {
+    return *entry->connection;
+}
+
+PooledConnection::operator bool() const {
+    return entry != nullptr;
+}
+
+sql::PreparedStatement* PooledConnection::prepare(const string& sql) {
+    if (entry->statements.size() >= MAX_CACHED_STATEMENTS && entry->statements.count(sql) == 0) {
+        transient.emplace_back(entry->connection->prepareStatement(sql));
+        return transient.back().get();
+    }
+    unique_ptr<sql::PreparedStatement>& cached = entry->statements[sql];
+    if (cached) {
+        cached->clearParameters();
+    } else {
+        cached.reset(entry->connection->prepareStatement(sql));
+    }
+    return cached.get();
+}
+
+void PooledConnection::discard() {
+    broken = true;
+}
+
+ConnectionPool::ConnectionPool(const PoolConfig& settings) : config(settings), openCount(0) {
+    if (config.maxConnections == 0) config.maxConnections = 1;
+    if (config.minConnections > config.maxConnections) config.minConnections = config.maxConnections;
+}
+
+ConnectionPool::~ConnectionPool() {
+    // Every PooledConnection holds a reference, so only idle ones remain
+    for (auto& entry : idle) {
+        try {
+            entry->connection->close();
+        } catch (...) {}
+    }
+    cout << "[ConnectionPool] Closed " << idle.size() << " pooled connection(s)." << endl;
+}
+
+unique_ptr<PoolEntry> ConnectionPool::open() {
+    // The driver singleton initializes the client library; not thread-safe
+    static mutex driverLock;
+    sql::Driver* driver;
+    {
+        lock_guard<mutex> guard(driverLock);
+        driver = get_driver_instance();
+    }
+
+    try {
+        string uri = "tcp://" + config.host + ":" + to_string(config.port);
+        unique_ptr<PoolEntry> entry(new PoolEntry());
+        entry->connection.reset(driver->connect(uri, config.user, config.password));
+        entry->connection->setSchema(config.schema);
+        entry->lastUsed = chrono::steady_clock::now();
+        return entry;
+    } catch (sql::SQLException& e) {
+        lock_guard<mutex> guard(lock);
+        lastError = e.what();
+        cerr << "SQL Connection Error: " << e.what() << endl;
+        return nullptr;
+    }
+}
+
+bool ConnectionPool::isHealthy(PoolEntry& entry) const {
+    try {
+        if (entry.connection->isClosed()) return false;
+        if (chrono::steady_clock::now() - entry.lastUsed < config.validateAfterIdle) return true;
+        return entry.connection->isValid();
+    } catch (sql::SQLException&) {
+        return false;
+    }
+}
+
+void ConnectionPool::release(unique_ptr<PoolEntry> entry, bool reusable) {
+    if (reusable) {
+        entry->lastUsed = chrono::steady_clock::now();
+        lock_guard<mutex> guard(lock);
+        idle.push_back(move(entry));
+    } else {
+        {
+            lock_guard<mutex> guard(lock);
+            openCount--;
+        }
+        try {
+            entry->connection->close();
+        } catch (...) {}
+    }
+    available.notify_one();
+}
+
+PooledConnection ConnectionPool::acquire() {
+    auto deadline = chrono::steady_clock::now() + config.checkoutTimeout;
+    unique_lock<mutex> guard(lock);
+
+    while (true) {
+        if (!idle.empty()) {
+            unique_ptr<PoolEntry> entry = move(idle.back());
+            idle.pop_back();
+            guard.unlock();
+
+            if (isHealthy(*entry)) {
+                return PooledConnection(shared_from_this(), move(entry));
+            }
+
+            // Dead connection (server restart, timeout); drop it and retry
+            cout << "[ConnectionPool] Dropping stale connection." << endl;
+            try {
+                entry->connection->close();
+            } catch (...) {}
+            guard.lock();
+            openCount--;
+            continue;
+        }
+
+        if (openCount < config.maxConnections) {
+            openCount++;
+            guard.unlock();
+
+            unique_ptr<PoolEntry> entry = open();
+            if (entry) {
+                return PooledConnection(shared_from_this(), move(entry));
+            }
+
+            guard.lock();
+            openCount--;
+            available.notify_one();
+            return PooledConnection();
+        }
+
+        if (available.wait_until(guard, deadline) == cv_status::timeout
+            && idle.empty() && openCount >= config.maxConnections) {
+            lastError = "Timed out waiting for a pooled database connection";
+            cerr << "[ConnectionPool] " << lastError << endl;
+            return PooledConnection();
+        }
+    }
+}
+
+bool ConnectionPool::warmUp() {
+    vector<PooledConnection> opened;
+    while (openConnections() < config.minConnections) {
+        PooledConnection connection = acquire();
+        if (!connection) return false;
+        opened.push_back(move(connection));
+    }
+    if (opened.empty()) {
+        // Already warm; make sure the server is still reachable
+        PooledConnection connection = acquire();
+        return (bool)connection;
+    }
+    return true;
+}
+
+size_t ConnectionPool::openConnections() {
+    lock_guard<mutex> guard(lock);
+    return openCount;
+}
+
+string ConnectionPool::getLastError() {
+    lock_guard<mutex> guard(lock);
+    return lastError;
+}
+
+shared_ptr<ConnectionPool> ConnectionPool::shared(const PoolConfig& settings) {
+    static mutex registryLock;
+    static map<string, weak_ptr<ConnectionPool>> registry;
+
+    string key = settings.user + "@" + settings.host + ":" + to_string(settings.port) + "/" + settings.schema;
+    lock_guard<mutex> guard(registryLock);
+    shared_ptr<ConnectionPool> pool = registry[key].lock();
+    if (!pool) {
+        pool = make_shared<ConnectionPool>(settings);
+        registry[key] = pool;
+    }
+    return pool;
+}
@@ -0,0 +1,112 @@
+// ConnectionPool.h
+#ifndef CONNECTIONPOOL_H
+#define CONNECTIONPOOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cppconn/driver.h>
+#include <cppconn/connection.h>
+#include <cppconn/prepared_statement.h>
+
+using namespace std;
+
+// Connection settings and pool limits
+struct PoolConfig {
+    string host, user, password, schema;
+    unsigned int port = 3306;
+    size_t minConnections = 1;                        // opened by warmUp()
+    size_t maxConnections = 8;                        // never more open at once
+    chrono::milliseconds checkoutTimeout{10000};      // wait for a free connection
+    chrono::milliseconds validateAfterIdle{30000};    // ping before reuse after this
+};
+
+// One pooled server connection plus bookkeeping
+struct PoolEntry {
+    unique_ptr<sql::Connection> connection;
+    chrono::steady_clock::time_point lastUsed;
+    // Statements prepared on this connection, keyed by SQL text. Declared
+    // after connection so they are freed first; a replacement connection
+    // starts with an empty cache.
+    map<string, unique_ptr<sql::PreparedStatement>> statements;
+};
+
+class ConnectionPool;
+
+// A checked-out connection. Goes back to the pool when destroyed, unless
+// discard() was called because the connection is no longer usable.
+class PooledConnection {
+private:
+    shared_ptr<ConnectionPool> pool;
+    unique_ptr<PoolEntry> entry;
+    vector<unique_ptr<sql::PreparedStatement>> transient; // prepared once the cache is full
+    bool broken;
+
+public:
+    PooledConnection();
+    PooledConnection(shared_ptr<ConnectionPool> owner, unique_ptr<PoolEntry> checkedOut);
+    PooledConnection(PooledConnection&& other) noexcept;
+    PooledConnection& operator=(PooledConnection&& other) noexcept;
+    ~PooledConnection();
+
+    sql::Connection* operator->() const;
+    sql::Connection& operator*() const;
+    explicit operator bool() const;
+
+    // Statement for sql, prepared on first use and then reused for as long
+    // as this connection stays open. Parameters are cleared; the caller must
+    // not delete it, and it stays valid at least until this handle is gone.
+    sql::PreparedStatement* prepare(const string& sql);
+
+    void discard();
+};
+
+// Thread-safe MySQL connection pool. DatabaseManager operations borrow a
+// connection for the duration of one call, so many threads can query and
+// store concurrently without a handshake per call.
+class ConnectionPool : public enable_shared_from_this<ConnectionPool> {
+    friend class PooledConnection;
+
+private:
+    PoolConfig config;
+    mutex lock;
+    condition_variable available;
+    vector<unique_ptr<PoolEntry>> idle; // most recently used at the back
+    size_t openCount;                   // idle + checked out + being opened
+    string lastError;
+
+    // New connection, or nullptr with lastError set
+    unique_ptr<PoolEntry> open();
+
+    // Called by PooledConnection; reusable == false closes the connection
+    void release(unique_ptr<PoolEntry> entry, bool reusable);
+
+    // Ping a connection that sat idle for a while
+    bool isHealthy(PoolEntry& entry) const;
+
+public:
+    explicit ConnectionPool(const PoolConfig& settings);
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    // Borrow a connection, waiting up to checkoutTimeout for one to free up.
+    // Returns an empty handle on failure; see getLastError().
+    PooledConnection acquire();
+
+    // Open minConnections up front; false if the server is unreachable
+    bool warmUp();
+
+    size_t openConnections();
+    string getLastError();
+
+    // Process-wide pool for these credentials, created on first use
+    static shared_ptr<ConnectionPool> shared(const PoolConfig& settings);
+};
+
+#endif
@@ -0,0 +1,46 @@
+// ContentCodec.cpp
+#include "ContentCodec.h"
+#include <zlib.h>
+
+// Below this the zlib header and the extra column cost more than they save
+static const size_t MIN_COMPRESS_SIZE = 512;
+static const size_t PREVIEW_BYTES = 100;
+
+static string previewOf(string_view text) {
+    if (text.size() <= PREVIEW_BYTES) return string(text);
+
+    // Don't split a multi-byte UTF-8 character
+    size_t end = PREVIEW_BYTES;
+    while (end > 0 && ((unsigned char)text[end] & 0xC0) == 0x80) end--;
+    return string(text.substr(0, end));
+}
+
+EncodedContent encodeContent(string_view text, bool enabled) {
+    EncodedContent encoded;
+    encoded.codec = CODEC_NONE;
+    encoded.preview = previewOf(text);
+    if (!enabled || text.size() < MIN_COMPRESS_SIZE) return encoded;
+
+    uLongf size = compressBound(text.size());
+    string blob(size, '\0');
+    int status = compress2((Bytef *)&blob[0], &size, (const Bytef *)text.data(), text.size(), Z_DEFAULT_COMPRESSION);
+    if (status != Z_OK || size >= text.size()) return encoded;
+
+    blob.resize(size);
+    encoded.codec = CODEC_ZLIB;
+    encoded.blob = move(blob);
+    return encoded;
+}
+
+bool decodeContent(ContentCodec codec, string_view blob, size_t originalSize, string& text) {
+    if (codec != CODEC_ZLIB) return false;
+
+    text.assign(originalSize, '\0');
+    uLongf size = originalSize;
+    int status = uncompress((Bytef *)&text[0], &size, (const Bytef *)blob.data(), blob.size());
+    if (status != Z_OK || size != originalSize) {
+        text.clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+// ContentCodec.h
+#ifndef CONTENTCODEC_H
+#define CONTENTCODEC_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// Value of stored_policies.content_codec
+enum ContentCodec : uint8_t {
+    CODEC_NONE = 0, // text in the content column
+    CODEC_ZLIB = 1  // zlib stream in content_blob
+};
+
+// Policy text as it goes into stored_policies
+struct EncodedContent {
+    ContentCodec codec;
+    string blob;    // compressed bytes; empty for CODEC_NONE
+    string preview; // leading text for listings, cut on a UTF-8 boundary
+};
+
+// Compress text unless it is small or does not shrink; compression off
+// (enabled == false) always yields CODEC_NONE
+EncodedContent encodeContent(string_view text, bool enabled = true);
+
+// Restore text from content_blob; originalSize is stored_policies.char_count.
+// False if the codec is unknown or the data is corrupt.
+bool decodeContent(ContentCodec codec, string_view blob, size_t originalSize, string& text);
+
+#endif
@@ -0,0 +1,101 @@
+// ContentHash.cpp
+#include "ContentHash.h"
+#include <cstring>
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+static uint64_t rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Little-endian loads regardless of alignment
+static uint64_t read64(const unsigned char* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+static uint32_t read32(const unsigned char* p) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+static uint64_t mixRound(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+static uint64_t mergeRound(uint64_t acc, uint64_t value) {
+    acc ^= mixRound(0, value);
+    return acc * PRIME1 + PRIME4;
+}
+
+uint64_t contentHash(string_view text, uint64_t seed) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text.data());
+    const unsigned char* end = p + text.size();
+    uint64_t hash;
+
+    if (text.size() >= 32) {
+        uint64_t v1 = seed + PRIME1 + PRIME2;
+        uint64_t v2 = seed + PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME1;
+        const unsigned char* limit = end - 32;
+        do {
+            v1 = mixRound(v1, read64(p));
+            v2 = mixRound(v2, read64(p + 8));
+            v3 = mixRound(v3, read64(p + 16));
+            v4 = mixRound(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        hash = mergeRound(hash, v1);
+        hash = mergeRound(hash, v2);
+        hash = mergeRound(hash, v3);
+        hash = mergeRound(hash, v4);
+    } else {
+        hash = seed + PRIME5;
+    }
+
+    hash += (uint64_t)text.size();
+
+    while (p + 8 <= end) {
+        hash ^= mixRound(0, read64(p));
+        hash = rotl(hash, 27) * PRIME1 + PRIME4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        hash ^= (uint64_t)read32(p) * PRIME1;
+        hash = rotl(hash, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    while (p < end) {
+        hash ^= (*p) * PRIME5;
+        hash = rotl(hash, 11) * PRIME1;
+        p++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+string contentHashHex(uint64_t hash) {
+    static const char digits[] = "0123456789abcdef";
+    string hex(16, '0');
+    for (int i = 15; i >= 0; i--) {
+        hex[i] = digits[hash & 0xF];
+        hash >>= 4;
+    }
+    return hex;
+}
@@ -0,0 +1,19 @@
+// ContentHash.h
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// 64-bit XXH64 of the text. Fast enough to run on every load and used
+// with seed 0 to recognize policies that were already stored; another
+// seed gives a second, independent hash of the same text.
+uint64_t contentHash(string_view text, uint64_t seed = 0);
+
+// Fixed-width lowercase hex form, for logs
+string contentHashHex(uint64_t hash);
+
+#endif
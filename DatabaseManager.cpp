@@ -1,16 +1,67 @@
 // DatabaseManager.cpp
 #include "DatabaseManager.h"
+#include "ContentHash.h"
+#include "ContentCodec.h"
+#include <cppconn/datatype.h>
+#include <algorithm>
 #include <ctime>
+#include <deque>
 #include <iomanip>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <streambuf>
 
-DatabaseManager::DatabaseManager() {
-    host = "127.0.0.1";          // localhost
-    user = "cppuser";             // New user
-    password = "cpppass";         // password you just set
-    schema = "privacy_db";        // database name
-    port = 3306;
-    driver = nullptr;
-    cout << "[DatabaseManager] Default constructor called." << endl;
+// Read-only istream buffer over existing memory, so large values can be
+// bound with setBlob without first copying them into a string
+class ViewStreamBuf : public streambuf {
+public:
+    explicit ViewStreamBuf(string_view view) {
+        char *begin = const_cast<char *>(view.data());
+        setg(begin, begin, begin + view.size());
+    }
+};
+
+// Streams handed to setBlob, kept alive until the statement has executed
+class BlobStreams {
+private:
+    deque<ViewStreamBuf> buffers;
+    deque<istream> streams;
+
+public:
+    istream *over(string_view data) {
+        buffers.emplace_back(data);
+        streams.emplace_back(&buffers.back());
+        return &streams.back();
+    }
+};
+
+// Columns written by every stored_policies insert, in bind order
+static const char *POLICY_COLUMNS = "(content, content_blob, content_codec, preview, source, filename, char_count, content_hash)";
+static const char *POLICY_VALUES = "(?, ?, ?, ?, ?, ?, ?, ?)";
+static const unsigned int POLICY_COLUMN_COUNT = 8;
+
+// Count rows per INSERT; keeps placeholders well under the server limit
+static const size_t COUNT_ROWS_PER_INSERT = 250;
+
+// Bind one stored_policies row starting after column `base`. Compressed
+// text goes to content_blob, anything else to content.
+static void bindPolicyRow(sql::PreparedStatement *pstmt, unsigned int base, string_view content,
+                          const EncodedContent &encoded, const string &source, const string &filename,
+                          uint64_t hash, BlobStreams &streams) {
+    if (encoded.codec == CODEC_NONE) {
+        pstmt->setBlob(base + 1, streams.over(content));
+        pstmt->setNull(base + 2, sql::DataType::LONGVARBINARY);
+    } else {
+        pstmt->setNull(base + 1, sql::DataType::LONGVARCHAR);
+        pstmt->setBlob(base + 2, streams.over(encoded.blob));
+    }
+    pstmt->setInt(base + 3, encoded.codec);
+    pstmt->setString(base + 4, encoded.preview);
+    pstmt->setString(base + 5, source);
+    pstmt->setString(base + 6, filename);
+    pstmt->setInt(base + 7, content.length());
+    pstmt->setUInt64(base + 8, hash);
 }
 
 DatabaseManager::DatabaseManager(string h, string u, string p, string s, unsigned int prt) {
@@ -19,7 +70,9 @@ DatabaseManager::DatabaseManager(string h, string u, string p, string s, unsigne
     password = p;
     schema = s;
     port = prt;
-    driver = nullptr;
+    compressionEnabled = true;
+    multiRowInserts = true;
+    initPool();
     cout << "[DatabaseManager] Parameterized constructor called." << endl;
 }
 
@@ -28,40 +81,68 @@ DatabaseManager::~DatabaseManager() {
     cout << "[DatabaseManager] Destructor called, connection closed." << endl;
 }
 
+void DatabaseManager::initPool() {
+    PoolConfig config;
+    config.host = host;
+    config.user = user;
+    config.password = password;
+    config.schema = schema;
+    config.port = port;
+    pool = ConnectionPool::shared(config);
+}
+
+PooledConnection DatabaseManager::borrow() {
+    PooledConnection conn = pool->acquire();
+    if (!conn) {
+        lastError = pool->getLastError();
+    }
+    return conn;
+}
+
+void DatabaseManager::noteError(PooledConnection &conn, sql::SQLException &e) {
+    lastError = e.what();
+    // CR_SERVER_GONE_ERROR / CR_SERVER_LOST: don't hand this one out again.
+    // ER_UNKNOWN_STMT_HANDLER: the server no longer knows our cached
+    // statements, so start over on a fresh connection and cache.
+    if (e.getErrorCode() == 2006 || e.getErrorCode() == 2013 || e.getErrorCode() == 1243) {
+        conn.discard();
+    }
+}
+
 bool DatabaseManager::connect() {
-    try {
-        driver = get_driver_instance();
-        string uri = "tcp://" + host + ":" + to_string(port);
-        conn.reset(driver->connect(uri, user, password));
-        if (!conn) return false;
-        conn->setSchema(schema);
-        cout << "[DatabaseManager] Connected to database successfully!" << endl;
-        return true;
-    } catch (sql::SQLException &e) {
-        lastError = e.what();
-        cerr << "SQL Connection Error: " << e.what() << endl;
+    // Opens the pool's minimum connections, or checks one still works
+    if (!pool->warmUp()) {
+        lastError = pool->getLastError();
         return false;
     }
+    cout << "[DatabaseManager] Connected to database successfully!" << endl;
+    return true;
 }
 
 void DatabaseManager::close() {
-    if (conn) {
-        try {
-            conn->close();
-        } catch (...) {}
-        conn.reset();
-        cout << "[DatabaseManager] Connection closed." << endl;
-    }
+    // Connections are borrowed per call and already back in the shared pool
 }
 
-bool DatabaseManager::createPolicyTable() {
-    if (!conn) {
-        if (!connect()) return false;
-    }
+void DatabaseManager::threadInit() {
+    get_driver_instance()->threadInit();
+}
 
-    try {
-        unique_ptr<sql::Statement> stmt(conn->createStatement());
-        string createTableSQL = R"(
+void DatabaseManager::threadEnd() {
+    get_driver_instance()->threadEnd();
+}
+
+// Schema changes in the order they were introduced. Append new versions;
+// never edit one that has shipped.
+struct SchemaMigration {
+    int version;
+    const char *description;
+    vector<const char *> statements;
+};
+
+static const vector<SchemaMigration> &schemaMigrations() {
+    static const vector<SchemaMigration> migrations = {
+        {1, "create policy and analysis tables", {
+            R"(
             CREATE TABLE IF NOT EXISTS stored_policies (
                 id INT AUTO_INCREMENT PRIMARY KEY,
                 content TEXT NOT NULL,
@@ -70,27 +151,8 @@ bool DatabaseManager::createPolicyTable() {
                 char_count INT,
                 analysis_date TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
                 created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
-            )
-        )";
-        
-        stmt->execute(createTableSQL);
-        cout << "[DatabaseManager] Policy table created/verified successfully." << endl;
-        return true;
-    } catch (sql::SQLException &e) {
-        lastError = e.what();
-        cerr << "SQL Error creating table: " << e.what() << endl;
-        return false;
-    }
-}
-
-bool DatabaseManager::createAnalysisTable() {
-    if (!conn) {
-        if (!connect()) return false;
-    }
-
-    try {
-        unique_ptr<sql::Statement> stmt(conn->createStatement());
-        string createTableSQL = R"(
+            ))",
+            R"(
             CREATE TABLE IF NOT EXISTS policy_analysis (
                 id INT AUTO_INCREMENT PRIMARY KEY,
                 policy_id INT NOT NULL,
@@ -98,125 +160,584 @@ bool DatabaseManager::createAnalysisTable() {
                 ai_summary TEXT,
                 analysis_date TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
                 FOREIGN KEY (policy_id) REFERENCES stored_policies(id) ON DELETE CASCADE
-            )
-        )";
-        
-        stmt->execute(createTableSQL);
-        cout << "[DatabaseManager] Analysis table created/verified successfully." << endl;
-        return true;
+            ))"
+        }},
+        {2, "content hash for deduplication", {
+            "ALTER TABLE stored_policies ADD COLUMN content_hash BIGINT UNSIGNED",
+            "ALTER TABLE stored_policies ADD INDEX idx_content_hash (content_hash)"
+        }},
+        {3, "indexes for analysis history and date ordering", {
+            "ALTER TABLE policy_analysis ADD INDEX idx_policy_date (policy_id, analysis_date)",
+            "ALTER TABLE stored_policies ADD INDEX idx_analysis_date (analysis_date)"
+        }},
+        {4, "compressed content and listing preview", {
+            // LONGTEXT also lifts the 64 KB ceiling for uncompressed rows
+            "ALTER TABLE stored_policies MODIFY content LONGTEXT NULL",
+            "ALTER TABLE stored_policies ADD COLUMN content_blob LONGBLOB NULL",
+            "ALTER TABLE stored_policies ADD COLUMN content_codec TINYINT UNSIGNED NOT NULL DEFAULT 0",
+            "ALTER TABLE stored_policies ADD COLUMN preview VARCHAR(100)",
+            "UPDATE stored_policies SET preview = LEFT(content, 100) WHERE preview IS NULL"
+        }},
+        {5, "structured keyword counts per analysis", {
+            // counted separates analyses stored with counts from older ones
+            "ALTER TABLE policy_analysis ADD COLUMN counted TINYINT UNSIGNED NOT NULL DEFAULT 0",
+            "ALTER TABLE policy_analysis ADD INDEX idx_policy_counted (policy_id, counted, id)",
+            R"(
+            CREATE TABLE IF NOT EXISTS analysis_category_counts (
+                analysis_id INT NOT NULL,
+                category VARCHAR(255) NOT NULL,
+                occurrences INT UNSIGNED NOT NULL,
+                PRIMARY KEY (analysis_id, category),
+                INDEX idx_category (category),
+                FOREIGN KEY (analysis_id) REFERENCES policy_analysis(id) ON DELETE CASCADE
+            ))",
+            R"(
+            CREATE TABLE IF NOT EXISTS analysis_keyword_counts (
+                analysis_id INT NOT NULL,
+                category VARCHAR(255) NOT NULL,
+                keyword VARCHAR(255) NOT NULL,
+                occurrences INT UNSIGNED NOT NULL,
+                PRIMARY KEY (analysis_id, category, keyword),
+                INDEX idx_keyword (keyword),
+                FOREIGN KEY (analysis_id) REFERENCES policy_analysis(id) ON DELETE CASCADE
+            ))"
+        }}
+    };
+    return migrations;
+}
+
+// Databases set up by builds that created tables on demand may already have
+// some of these columns and indexes
+static bool alreadyApplied(const sql::SQLException &e) {
+    return e.getErrorCode() == 1060    // ER_DUP_FIELDNAME
+        || e.getErrorCode() == 1061;   // ER_DUP_KEYNAME
+}
+
+int DatabaseManager::latestSchemaVersion() {
+    return schemaMigrations().back().version;
+}
+
+bool DatabaseManager::migrateSchema() {
+    PooledConnection conn = borrow();
+    if (!conn) return false;
+
+    try {
+        unique_ptr<sql::Statement> stmt(conn->createStatement());
+        stmt->execute(
+            "CREATE TABLE IF NOT EXISTS schema_version ("
+            "version INT NOT NULL PRIMARY KEY, "
+            "description VARCHAR(255), "
+            "applied_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP)"
+        );
+
+        // Serialize with other processes starting up against the same schema
+        unique_ptr<sql::ResultSet> locked(stmt->executeQuery(
+            "SELECT GET_LOCK('privacy_analyzer_schema', 30) AS locked"));
+        if (!locked->next() || locked->getInt("locked") != 1) {
+            lastError = "Timed out waiting for the schema migration lock";
+            cerr << "[DatabaseManager] " << lastError << endl;
+            return false;
+        }
+
+        unique_ptr<sql::ResultSet> res(stmt->executeQuery(
+            "SELECT COALESCE(MAX(version), 0) AS version FROM schema_version"));
+        int current = res->next() ? res->getInt("version") : 0;
+
+        bool ok = true;
+        for (const auto &migration : schemaMigrations()) {
+            if (migration.version <= current) continue;
+
+            cout << "[DatabaseManager] Applying schema version " << migration.version
+                 << ": " << migration.description << endl;
+            try {
+                for (const char *statement : migration.statements) {
+                    try {
+                        stmt->execute(statement);
+                    } catch (sql::SQLException &e) {
+                        if (!alreadyApplied(e)) throw;
+                    }
+                }
+                unique_ptr<sql::PreparedStatement> record(conn->prepareStatement(
+                    "INSERT INTO schema_version (version, description) VALUES (?, ?)"));
+                record->setInt(1, migration.version);
+                record->setString(2, migration.description);
+                record->executeUpdate();
+            } catch (sql::SQLException &e) {
+                noteError(conn, e);
+                cerr << "SQL Error applying schema version " << migration.version << ": " << e.what() << endl;
+                ok = false;
+                break;
+            }
+        }
+
+        stmt->execute("DO RELEASE_LOCK('privacy_analyzer_schema')");
+        if (ok) {
+            cout << "[DatabaseManager] Schema is at version " << latestSchemaVersion() << "." << endl;
+        }
+        return ok;
     } catch (sql::SQLException &e) {
-        lastError = e.what();
-        cerr << "SQL Error creating analysis table: " << e.what() << endl;
+        noteError(conn, e);
+        cerr << "SQL Error migrating schema: " << e.what() << endl;
+        // The lock belongs to the session, which goes back to the pool
+        try {
+            unique_ptr<sql::Statement> stmt(conn->createStatement());
+            stmt->execute("DO RELEASE_LOCK('privacy_analyzer_schema')");
+        } catch (sql::SQLException &) {}
         return false;
     }
 }
 
-bool DatabaseManager::storePolicy(const string& content, const string& source, const string& filename) {
-    if (!conn) {
-        if (!connect()) return false;
-    }
+int DatabaseManager::lastInsertId(PooledConnection &conn) {
+    sql::PreparedStatement *pstmt = conn.prepare("SELECT LAST_INSERT_ID() AS id");
+    unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    return res->next() ? res->getInt("id") : -1;
+}
 
-    // Ensure table exists
-    if (!createPolicyTable()) {
-        return false;
-    }
+int DatabaseManager::storePolicy(string_view content, const string& source, const string& filename, uint64_t hash) {
+    PooledConnection conn = borrow();
+    if (!conn) return -1;
 
     try {
-        string insertSQL = "INSERT INTO stored_policies (content, source, filename, char_count) VALUES (?, ?, ?, ?)";
-        unique_ptr<sql::PreparedStatement> pstmt(conn->prepareStatement(insertSQL));
+        string insertSQL = string("INSERT INTO stored_policies ") + POLICY_COLUMNS + " VALUES " + POLICY_VALUES;
+        sql::PreparedStatement *pstmt = conn.prepare(insertSQL);
         
-        pstmt->setString(1, content);
-        pstmt->setString(2, source);
-        pstmt->setString(3, filename);
-        pstmt->setInt(4, content.length());
+        EncodedContent encoded = encodeContent(content, compressionEnabled);
+        BlobStreams streams;
+        bindPolicyRow(pstmt, 0, content, encoded, source, filename,
+                      hash != 0 ? hash : contentHash(content), streams);
         
         pstmt->executeUpdate();
-        cout << "[DatabaseManager] Policy stored successfully. Characters: " << content.length() << endl;
-        return true;
+        // Per-connection value, so concurrent writers cannot interfere
+        int policy_id = lastInsertId(conn);
+        cout << "[DatabaseManager] Policy stored successfully with ID " << policy_id << ". Characters: " << content.length();
+        if (encoded.codec != CODEC_NONE) {
+            cout << " (compressed to " << encoded.blob.size() << " bytes)";
+        }
+        cout << endl;
+        return policy_id;
     } catch (sql::SQLException &e) {
-        lastError = e.what();
+        noteError(conn, e);
         cerr << "SQL Error storing policy: " << e.what() << endl;
-        return false;
+        return -1;
     }
 }
 
-bool DatabaseManager::storeAnalysisResults(int policy_id, const string& keyword_analysis, const string& ai_summary) {
-    if (!conn) {
-        if (!connect()) return false;
+bool DatabaseManager::insertedIds(PooledConnection &conn, const string &table, const string &column,
+                                  const vector<uint64_t> &expected, vector<int> &ids) {
+    // LAST_INSERT_ID is the first row of the statement; InnoDB hands a
+    // multi-row VALUES insert a run of ids spaced by the increment
+    int first = lastInsertId(conn);
+    sql::PreparedStatement *step = conn.prepare("SELECT @@auto_increment_increment AS step");
+    unique_ptr<sql::ResultSet> res(step->executeQuery());
+    int increment = res->next() ? res->getInt("step") : 1;
+
+    ids.clear();
+    for (size_t i = 0; i < expected.size(); i++) {
+        ids.push_back(first + (int)i * increment);
     }
 
-    // Ensure table exists
-    if (!createAnalysisTable()) {
+    // Confirm the run against the values just written, in case the server
+    // interleaved ids with another session
+    sql::PreparedStatement *check = conn.prepare(
+        "SELECT id, " + column + " AS written FROM " + table + " WHERE id BETWEEN ? AND ?");
+    check->setInt(1, ids.front());
+    check->setInt(2, ids.back());
+    unique_ptr<sql::ResultSet> found(check->executeQuery());
+    size_t matched = 0;
+    while (found->next()) {
+        int id = found->getInt("id");
+        if ((id - first) % increment != 0) continue;
+        size_t row = (size_t)((id - first) / increment);
+        if (row < expected.size() && found->getUInt64("written") == expected[row]) {
+            matched++;
+        }
+    }
+    return matched == expected.size();
+}
+
+bool DatabaseManager::writeBatch(PooledConnection &conn, const vector<PolicyWrite>& rows, const vector<size_t>& inserted,
+                                 const vector<size_t>& analyzed, const vector<uint64_t>& hashes,
+                                 const vector<EncodedContent>& encoded, bool multiRow,
+                                 vector<int>& policy_ids, vector<int>& analysis_ids) {
+    BlobStreams streams;
+    policy_ids.assign(rows.size(), -1);
+    analysis_ids.clear();
+
+    if (!inserted.empty()) {
+        vector<int> ids;
+        if (multiRow) {
+            string insertSQL = string("INSERT INTO stored_policies ") + POLICY_COLUMNS + " VALUES ";
+            vector<uint64_t> expected;
+            for (size_t n = 0; n < inserted.size(); n++) {
+                insertSQL += n == 0 ? POLICY_VALUES : string(", ") + POLICY_VALUES;
+                expected.push_back(hashes[inserted[n]]);
+            }
+            sql::PreparedStatement *insertPolicies = conn.prepare(insertSQL);
+            for (size_t n = 0; n < inserted.size(); n++) {
+                const PolicyWrite &row = rows[inserted[n]];
+                bindPolicyRow(insertPolicies, (unsigned int)n * POLICY_COLUMN_COUNT, row.text(), encoded[inserted[n]],
+                              row.source, row.filename, hashes[inserted[n]], streams);
+            }
+            insertPolicies->executeUpdate();
+            if (!insertedIds(conn, "stored_policies", "content_hash", expected, ids)) return false;
+        } else {
+            sql::PreparedStatement *insertOne = conn.prepare(
+                string("INSERT INTO stored_policies ") + POLICY_COLUMNS + " VALUES " + POLICY_VALUES);
+            for (size_t i : inserted) {
+                bindPolicyRow(insertOne, 0, rows[i].text(), encoded[i], rows[i].source, rows[i].filename,
+                              hashes[i], streams);
+                insertOne->executeUpdate();
+                ids.push_back(lastInsertId(conn));
+            }
+        }
+        for (size_t n = 0; n < inserted.size(); n++) {
+            policy_ids[inserted[n]] = ids[n];
+        }
+    }
+
+    // Analysis rows point at a stored policy or at an earlier row
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (rows[i].policy_id >= 0) {
+            policy_ids[i] = rows[i].policy_id;
+        } else if (rows[i].policy_row >= 0 && rows[i].policy_row < (int)i) {
+            policy_ids[i] = policy_ids[rows[i].policy_row];
+        }
+    }
+    if (analyzed.empty()) return true;
+
+    string insertSQL = "INSERT INTO policy_analysis (policy_id, keyword_analysis, ai_summary, counted) VALUES ";
+    if (multiRow) {
+        vector<uint64_t> expected;
+        for (size_t n = 0; n < analyzed.size(); n++) {
+            insertSQL += n == 0 ? "(?, ?, ?, ?)" : ", (?, ?, ?, ?)";
+            expected.push_back((uint64_t)policy_ids[analyzed[n]]);
+        }
+        sql::PreparedStatement *insertAnalyses = conn.prepare(insertSQL);
+        for (size_t n = 0; n < analyzed.size(); n++) {
+            const PolicyWrite &row = rows[analyzed[n]];
+            unsigned int column = (unsigned int)n * 4;
+            insertAnalyses->setInt(column + 1, policy_ids[analyzed[n]]);
+            insertAnalyses->setString(column + 2, row.keyword_analysis);
+            insertAnalyses->setString(column + 3, row.ai_summary);
+            insertAnalyses->setInt(column + 4, row.counts.counted ? 1 : 0);
+        }
+        insertAnalyses->executeUpdate();
+        return insertedIds(conn, "policy_analysis", "policy_id", expected, analysis_ids);
+    }
+
+    sql::PreparedStatement *insertOne = conn.prepare(insertSQL + "(?, ?, ?, ?)");
+    for (size_t i : analyzed) {
+        insertOne->setInt(1, policy_ids[i]);
+        insertOne->setString(2, rows[i].keyword_analysis);
+        insertOne->setString(3, rows[i].ai_summary);
+        insertOne->setInt(4, rows[i].counts.counted ? 1 : 0);
+        insertOne->executeUpdate();
+        analysis_ids.push_back(lastInsertId(conn));
+    }
+    return true;
+}
+
+bool DatabaseManager::storePolicyBatch(const vector<PolicyWrite>& rows, vector<int>& policy_ids) {
+    if (rows.empty()) return true;
+
+    PooledConnection conn = borrow();
+    if (!conn) return false;
+
+    vector<size_t> inserted; // rows that insert a policy
+    vector<size_t> analyzed; // rows that carry an analysis
+    vector<uint64_t> hashes(rows.size(), 0);
+    vector<EncodedContent> encoded(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (rows[i].storesPolicy()) {
+            hashes[i] = rows[i].hash != 0 ? rows[i].hash : contentHash(rows[i].text());
+            encoded[i] = encodeContent(rows[i].text(), compressionEnabled);
+            inserted.push_back(i);
+        } else if (rows[i].policy_row >= (int)i || (rows[i].policy_row >= 0 && !rows[rows[i].policy_row].storesPolicy())) {
+            lastError = "Analysis row refers to a row that stores no policy";
+            cerr << "[DatabaseManager] " << lastError << endl;
+            return false;
+        }
+        if (!rows[i].keyword_analysis.empty()) {
+            analyzed.push_back(i);
+        }
+    }
+
+    try {
+        conn->setAutoCommit(false);
+
+        vector<int> ids;
+        vector<int> analysisIds;
+        if (!multiRowInserts) {
+            writeBatch(conn, rows, inserted, analyzed, hashes, encoded, false, ids, analysisIds);
+        } else if (!writeBatch(conn, rows, inserted, analyzed, hashes, encoded, true, ids, analysisIds)) {
+            // The server interleaved ids with another session; redo the
+            // batch one row at a time inside a fresh transaction
+            conn->rollback();
+            writeBatch(conn, rows, inserted, analyzed, hashes, encoded, false, ids, analysisIds);
+        }
+
+        vector<pair<int, const AnalysisCounts*>> counted;
+        for (size_t n = 0; n < analyzed.size(); n++) {
+            if (rows[analyzed[n]].counts.counted) {
+                counted.push_back(make_pair(analysisIds[n], &rows[analyzed[n]].counts));
+            }
+        }
+        insertCounts(conn, counted);
+
+        conn->commit();
+        conn->setAutoCommit(true);
+        policy_ids.insert(policy_ids.end(), ids.begin(), ids.end());
+        cout << "[DatabaseManager] Stored batch of " << inserted.size() << " policies and "
+             << analyzed.size() << " analyses." << endl;
+        return true;
+    } catch (sql::SQLException &e) {
+        noteError(conn, e);
+        cerr << "SQL Error storing policy batch: " << e.what() << endl;
+        try {
+            conn->rollback();
+            conn->setAutoCommit(true);
+        } catch (sql::SQLException &) {
+            conn.discard();
+        }
         return false;
     }
+}
+
+void DatabaseManager::insertCounts(PooledConnection &conn, const vector<pair<int, const AnalysisCounts*>>& analyses) {
+    // Flattened so each table takes a few multi-row INSERTs however the
+    // rows are spread over analyses
+    vector<pair<int, const CategoryCount*>> categories;
+    vector<pair<int, const KeywordCount*>> keywords;
+    for (const auto& analysis : analyses) {
+        for (const auto& row : analysis.second->categories) categories.push_back(make_pair(analysis.first, &row));
+        for (const auto& row : analysis.second->keywords) keywords.push_back(make_pair(analysis.first, &row));
+    }
+
+    for (size_t start = 0; start < categories.size(); start += COUNT_ROWS_PER_INSERT) {
+        size_t count = min(COUNT_ROWS_PER_INSERT, categories.size() - start);
+        string insertSQL = "INSERT INTO analysis_category_counts (analysis_id, category, occurrences) VALUES ";
+        for (size_t n = 0; n < count; n++) {
+            insertSQL += n == 0 ? "(?, ?, ?)" : ", (?, ?, ?)";
+        }
+        sql::PreparedStatement *pstmt = conn.prepare(insertSQL);
+        for (size_t n = 0; n < count; n++) {
+            unsigned int column = (unsigned int)n * 3;
+            pstmt->setInt(column + 1, categories[start + n].first);
+            pstmt->setString(column + 2, categories[start + n].second->category);
+            pstmt->setUInt64(column + 3, categories[start + n].second->occurrences);
+        }
+        pstmt->executeUpdate();
+    }
+
+    for (size_t start = 0; start < keywords.size(); start += COUNT_ROWS_PER_INSERT) {
+        size_t count = min(COUNT_ROWS_PER_INSERT, keywords.size() - start);
+        string insertSQL = "INSERT INTO analysis_keyword_counts (analysis_id, category, keyword, occurrences) VALUES ";
+        for (size_t n = 0; n < count; n++) {
+            insertSQL += n == 0 ? "(?, ?, ?, ?)" : ", (?, ?, ?, ?)";
+        }
+        sql::PreparedStatement *pstmt = conn.prepare(insertSQL);
+        for (size_t n = 0; n < count; n++) {
+            unsigned int column = (unsigned int)n * 4;
+            pstmt->setInt(column + 1, keywords[start + n].first);
+            pstmt->setString(column + 2, keywords[start + n].second->category);
+            pstmt->setString(column + 3, keywords[start + n].second->keyword);
+            pstmt->setUInt64(column + 4, keywords[start + n].second->occurrences);
+        }
+        pstmt->executeUpdate();
+    }
+}
+
+bool DatabaseManager::storeAnalysisResults(int policy_id, const string& keyword_analysis, const string& ai_summary,
+                                           const AnalysisCounts& counts) {
+    PooledConnection conn = borrow();
+    if (!conn) return false;
 
     try {
-        string insertSQL = "INSERT INTO policy_analysis (policy_id, keyword_analysis, ai_summary) VALUES (?, ?, ?)";
-        unique_ptr<sql::PreparedStatement> pstmt(conn->prepareStatement(insertSQL));
+        // The analysis and its count rows are stored together or not at all
+        if (counts.counted) conn->setAutoCommit(false);
+
+        string insertSQL = "INSERT INTO policy_analysis (policy_id, keyword_analysis, ai_summary, counted) VALUES (?, ?, ?, ?)";
+        sql::PreparedStatement *pstmt = conn.prepare(insertSQL);
         
         pstmt->setInt(1, policy_id);
         pstmt->setString(2, keyword_analysis);
         pstmt->setString(3, ai_summary);
+        pstmt->setInt(4, counts.counted ? 1 : 0);
         
         pstmt->executeUpdate();
+        if (counts.counted) {
+            insertCounts(conn, {make_pair(lastInsertId(conn), &counts)});
+            conn->commit();
+            conn->setAutoCommit(true);
+        }
         cout << "[DatabaseManager] Analysis results stored successfully for policy ID: " << policy_id << endl;
         return true;
     } catch (sql::SQLException &e) {
-        lastError = e.what();
+        noteError(conn, e);
         cerr << "SQL Error storing analysis: " << e.what() << endl;
+        if (counts.counted) {
+            try {
+                conn->rollback();
+                conn->setAutoCommit(true);
+            } catch (sql::SQLException &) {
+                conn.discard();
+            }
+        }
         return false;
     }
 }
 
+string DatabaseManager::readContent(sql::ResultSet &res, size_t char_count) {
+    ContentCodec codec = (ContentCodec)res.getInt("content_codec");
+    if (codec == CODEC_NONE) {
+        return res.getString("content");
+    }
+
+    unique_ptr<istream> blob(res.getBlob("content_blob"));
+    string compressed((istreambuf_iterator<char>(*blob)), istreambuf_iterator<char>());
+    string text;
+    if (!decodeContent(codec, compressed, char_count, text)) {
+        lastError = "Could not decompress policy content (codec " + to_string((int)codec) + ")";
+        cerr << "[DatabaseManager] " << lastError << endl;
+    }
+    return text;
+}
+
 vector<PolicyRecord> DatabaseManager::getStoredPolicies() {
     vector<PolicyRecord> policies;
     
-    if (!conn) {
-        if (!connect()) return policies;
-    }
+    PooledConnection conn = borrow();
+    if (!conn) return policies;
 
     try {
         unique_ptr<sql::Statement> stmt(conn->createStatement());
         unique_ptr<sql::ResultSet> res(stmt->executeQuery(
-            "SELECT id, content, source, filename, char_count, analysis_date FROM stored_policies ORDER BY analysis_date DESC"
+            "SELECT id, content, content_blob, content_codec, source, filename, char_count, analysis_date "
+            "FROM stored_policies ORDER BY analysis_date DESC"
         ));
         
         while (res->next()) {
             PolicyRecord record;
             record.id = res->getInt("id");
-            record.content = res->getString("content");
             record.source = res->getString("source");
             record.filename = res->getString("filename");
             record.char_count = res->getInt("char_count");
+            record.content = readContent(*res, record.char_count);
             record.analysis_date = res->getString("analysis_date");
             
             policies.push_back(record);
         }
         cout << "[DatabaseManager] Retrieved " << policies.size() << " stored policies." << endl;
     } catch (sql::SQLException &e) {
-        lastError = e.what();
+        noteError(conn, e);
         cerr << "SQL Error retrieving policies: " << e.what() << endl;
     }
 
     return policies;
 }
 
+bool DatabaseManager::forEachPolicy(const function<bool(const PolicyRecord&)>& visit, int batchSize) {
+    // Connector/C++ buffers a whole result set client-side, so the table is
+    // walked in keyset batches rather than with one large SELECT
+    batchSize = max(batchSize, 1);
+    int afterId = 0;
+    while (true) {
+        vector<PolicyRecord> batch;
+        {
+            PooledConnection conn = borrow();
+            if (!conn) return false;
+
+            try {
+                string querySQL =
+                    "SELECT id, content, content_blob, content_codec, source, filename, char_count, analysis_date "
+                    "FROM stored_policies WHERE id > ? ORDER BY id LIMIT ?";
+                sql::PreparedStatement *pstmt = conn.prepare(querySQL);
+                pstmt->setInt(1, afterId);
+                pstmt->setInt(2, batchSize);
+
+                unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+                while (res->next()) {
+                    PolicyRecord record;
+                    record.id = res->getInt("id");
+                    record.source = res->getString("source");
+                    record.filename = res->getString("filename");
+                    record.char_count = res->getInt("char_count");
+                    record.content = readContent(*res, record.char_count);
+                    record.analysis_date = res->getString("analysis_date");
+                    batch.push_back(move(record));
+                }
+            } catch (sql::SQLException &e) {
+                noteError(conn, e);
+                cerr << "SQL Error streaming policies: " << e.what() << endl;
+                return false;
+            }
+        }
+
+        // The connection is back in the pool before visit runs, so the
+        // visitor can write through this store without starving it
+        for (const auto& record : batch) {
+            if (!visit(record)) return true;
+        }
+        if ((int)batch.size() < batchSize) return true;
+        afterId = batch.back().id;
+    }
+}
+
+vector<PolicySummary> DatabaseManager::listPolicies(int beforeId, int limit) {
+    vector<PolicySummary> page;
+
+    PooledConnection conn = borrow();
+    if (!conn) return page;
+
+    try {
+        // Keyset pagination on the primary key; the count uses the
+        // policy_analysis(policy_id) index, so no analysis text is read
+        string querySQL =
+            "SELECT p.id, p.source, p.filename, p.char_count, p.analysis_date, "
+            "p.preview, "
+            "(SELECT COUNT(*) FROM policy_analysis a WHERE a.policy_id = p.id) AS analysis_count "
+            "FROM stored_policies p WHERE p.id < ? ORDER BY p.id DESC LIMIT ?";
+        sql::PreparedStatement *pstmt = conn.prepare(querySQL);
+        pstmt->setInt(1, beforeId > 0 ? beforeId : numeric_limits<int>::max());
+        pstmt->setInt(2, limit);
+
+        unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+        while (res->next()) {
+            PolicySummary summary;
+            summary.id = res->getInt("id");
+            summary.source = res->getString("source");
+            summary.filename = res->getString("filename");
+            summary.char_count = res->getInt("char_count");
+            summary.analysis_date = res->getString("analysis_date");
+            summary.preview = res->getString("preview");
+            summary.analysis_count = res->getInt("analysis_count");
+
+            page.push_back(summary);
+        }
+    } catch (sql::SQLException &e) {
+        noteError(conn, e);
+        cerr << "SQL Error listing policies: " << e.what() << endl;
+    }
+
+    return page;
+}
+
 vector<AnalysisResult> DatabaseManager::getAnalysisResults(int policy_id) {
     vector<AnalysisResult> results;
     
-    if (!conn) {
-        if (!connect()) return results;
-    }
+    PooledConnection conn = borrow();
+    if (!conn) return results;
 
     try {
-        string querySQL = "SELECT policy_id, keyword_analysis, ai_summary, analysis_date FROM policy_analysis WHERE policy_id = ? ORDER BY analysis_date DESC";
-        unique_ptr<sql::PreparedStatement> pstmt(conn->prepareStatement(querySQL));
+        string querySQL = "SELECT id, policy_id, keyword_analysis, ai_summary, analysis_date FROM policy_analysis WHERE policy_id = ? ORDER BY analysis_date DESC";
+        sql::PreparedStatement *pstmt = conn.prepare(querySQL);
         pstmt->setInt(1, policy_id);
         
         unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
         
         while (res->next()) {
             AnalysisResult result;
+            result.id = res->getInt("id");
             result.policy_id = res->getInt("policy_id");
             result.keyword_analysis = res->getString("keyword_analysis");
             result.ai_summary = res->getString("ai_summary");
@@ -226,19 +747,205 @@ vector<AnalysisResult> DatabaseManager::getAnalysisResults(int policy_id) {
         }
         cout << "[DatabaseManager] Retrieved " << results.size() << " analysis results for policy ID: " << policy_id << endl;
     } catch (sql::SQLException &e) {
-        lastError = e.what();
+        noteError(conn, e);
         cerr << "SQL Error retrieving analysis: " << e.what() << endl;
     }
 
     return results;
 }
 
+int DatabaseManager::getLatestPolicyId() {
+    PooledConnection conn = borrow();
+    if (!conn) return -1;
+
+    try {
+        unique_ptr<sql::Statement> stmt(conn->createStatement());
+        unique_ptr<sql::ResultSet> res(stmt->executeQuery("SELECT id FROM stored_policies ORDER BY id DESC LIMIT 1"));
+        if (res->next()) {
+            return res->getInt("id");
+        }
+    } catch (sql::SQLException &e) {
+        noteError(conn, e);
+        cerr << "SQL Error retrieving latest policy id: " << e.what() << endl;
+    }
+
+    return -1;
+}
+
+int DatabaseManager::findPolicyByHash(uint64_t hash, size_t char_count) {
+    PooledConnection conn = borrow();
+    if (!conn) return -1;
+
+    try {
+        // char_count guards against the (unlikely) hash collision
+        string querySQL = "SELECT id FROM stored_policies WHERE content_hash = ? AND char_count = ? ORDER BY id LIMIT 1";
+        sql::PreparedStatement *pstmt = conn.prepare(querySQL);
+        pstmt->setUInt64(1, hash);
+        pstmt->setInt(2, char_count);
+
+        unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+        if (res->next()) {
+            return res->getInt("id");
+        }
+    } catch (sql::SQLException &e) {
+        noteError(conn, e);
+        cerr << "SQL Error looking up policy hash: " << e.what() << endl;
+    }
+
+    return -1;
+}
+
+bool DatabaseManager::forEachAnalysis(int policy_id, const function<bool(const AnalysisResult&)>& visit, int batchSize) {
+    batchSize = max(batchSize, 1);
+    int afterId = 0;
+    while (true) {
+        vector<AnalysisResult> batch;
+        {
+            PooledConnection conn = borrow();
+            if (!conn) return false;
+
+            try {
+                // Separate statements for one policy and for all, so the
+                // single-policy walk stays on the policy_id index
+                string querySQL = policy_id < 0
+                    ? "SELECT id, policy_id, keyword_analysis, ai_summary, analysis_date FROM policy_analysis "
+                      "WHERE id > ? ORDER BY id LIMIT ?"
+                    : "SELECT id, policy_id, keyword_analysis, ai_summary, analysis_date FROM policy_analysis "
+                      "WHERE policy_id = ? AND id > ? ORDER BY id LIMIT ?";
+                sql::PreparedStatement *pstmt = conn.prepare(querySQL);
+                int param = 1;
+                if (policy_id >= 0) pstmt->setInt(param++, policy_id);
+                pstmt->setInt(param++, afterId);
+                pstmt->setInt(param, batchSize);
+
+                unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+                while (res->next()) {
+                    AnalysisResult result;
+                    result.id = res->getInt("id");
+                    result.policy_id = res->getInt("policy_id");
+                    result.keyword_analysis = res->getString("keyword_analysis");
+                    result.ai_summary = res->getString("ai_summary");
+                    result.analysis_date = res->getString("analysis_date");
+                    batch.push_back(move(result));
+                }
+            } catch (sql::SQLException &e) {
+                noteError(conn, e);
+                cerr << "SQL Error streaming analyses: " << e.what() << endl;
+                return false;
+            }
+        }
+
+        for (const auto& result : batch) {
+            if (!visit(result)) return true;
+        }
+        if ((int)batch.size() < batchSize) return true;
+        afterId = batch.back().id;
+    }
+}
+
+bool DatabaseManager::getLatestAnalysis(int policy_id, AnalysisResult& result) {
+    PooledConnection conn = borrow();
+    if (!conn) return false;
+
+    try {
+        string querySQL = "SELECT id, policy_id, keyword_analysis, ai_summary, analysis_date FROM policy_analysis WHERE policy_id = ? ORDER BY analysis_date DESC, id DESC LIMIT 1";
+        sql::PreparedStatement *pstmt = conn.prepare(querySQL);
+        pstmt->setInt(1, policy_id);
+
+        unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+        if (res->next()) {
+            result.id = res->getInt("id");
+            result.policy_id = res->getInt("policy_id");
+            result.keyword_analysis = res->getString("keyword_analysis");
+            result.ai_summary = res->getString("ai_summary");
+            result.analysis_date = res->getString("analysis_date");
+            return true;
+        }
+    } catch (sql::SQLException &e) {
+        noteError(conn, e);
+        cerr << "SQL Error retrieving latest analysis: " << e.what() << endl;
+    }
+
+    return false;
+}
+
+bool DatabaseManager::getAnalysisCounts(int analysis_id, AnalysisCounts& counts) {
+    counts = AnalysisCounts();
+
+    PooledConnection conn = borrow();
+    if (!conn) return false;
+
+    try {
+        sql::PreparedStatement *pstmt = conn.prepare("SELECT counted FROM policy_analysis WHERE id = ?");
+        pstmt->setInt(1, analysis_id);
+        unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+        if (!res->next() || res->getInt("counted") == 0) return true;
+
+        pstmt = conn.prepare("SELECT category, occurrences FROM analysis_category_counts WHERE analysis_id = ?");
+        pstmt->setInt(1, analysis_id);
+        res.reset(pstmt->executeQuery());
+        while (res->next()) {
+            counts.categories.push_back({res->getString("category"), (size_t)res->getUInt64("occurrences")});
+        }
+
+        pstmt = conn.prepare("SELECT category, keyword, occurrences FROM analysis_keyword_counts WHERE analysis_id = ?");
+        pstmt->setInt(1, analysis_id);
+        res.reset(pstmt->executeQuery());
+        while (res->next()) {
+            counts.keywords.push_back({res->getString("category"), res->getString("keyword"),
+                                       (size_t)res->getUInt64("occurrences")});
+        }
+        counts.counted = true;
+        return true;
+    } catch (sql::SQLException &e) {
+        noteError(conn, e);
+        cerr << "SQL Error reading analysis counts: " << e.what() << endl;
+    }
+
+    return false;
+}
+
+vector<CoverageStat> DatabaseManager::getCoverage(bool byKeyword) {
+    vector<CoverageStat> stats;
+
+    PooledConnection conn = borrow();
+    if (!conn) return stats;
+
+    try {
+        // idx_policy_counted answers the inner query from the index alone;
+        // the count tables are then read by primary key
+        string latestSQL =
+            "(SELECT MAX(id) AS id FROM policy_analysis WHERE counted = 1 GROUP BY policy_id) latest ";
+        string querySQL = byKeyword
+            ? "SELECT c.category, c.keyword, COUNT(*) AS policies, SUM(c.occurrences) AS occurrences FROM "
+              + latestSQL + "JOIN analysis_keyword_counts c ON c.analysis_id = latest.id "
+              "GROUP BY c.category, c.keyword ORDER BY policies DESC, occurrences DESC, c.category, c.keyword"
+            : "SELECT c.category, '' AS keyword, COUNT(*) AS policies, SUM(c.occurrences) AS occurrences FROM "
+              + latestSQL + "JOIN analysis_category_counts c ON c.analysis_id = latest.id "
+              "GROUP BY c.category ORDER BY policies DESC, occurrences DESC, c.category";
+        sql::PreparedStatement *pstmt = conn.prepare(querySQL);
+
+        unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+        while (res->next()) {
+            CoverageStat stat;
+            stat.category = res->getString("category");
+            stat.keyword = res->getString("keyword");
+            stat.policies = res->getInt("policies");
+            stat.occurrences = res->getUInt64("occurrences");
+            stats.push_back(stat);
+        }
+    } catch (sql::SQLException &e) {
+        noteError(conn, e);
+        cerr << "SQL Error computing coverage: " << e.what() << endl;
+    }
+
+    return stats;
+}
+
 vector<pair<string, string>> DatabaseManager::getKeywords() {
     vector<pair<string, string>> keywords;
-    if (!conn) {
-        cerr << "[DatabaseManager] Not connected to DB." << endl;
-        return keywords;
-    }
+    PooledConnection conn = borrow();
+    if (!conn) return keywords;
 
     try {
         unique_ptr<sql::Statement> stmt(conn->createStatement());
@@ -250,13 +957,46 @@ vector<pair<string, string>> DatabaseManager::getKeywords() {
         }
         cout << "[DatabaseManager] Keywords fetched: " << keywords.size() << endl;
     } catch (sql::SQLException &e) {
-        lastError = e.what();
+        noteError(conn, e);
         cerr << "SQL Error: " << e.what() << endl;
     }
 
     return keywords;
 }
 
+string DatabaseManager::getKeywordsVersion() {
+    PooledConnection conn = borrow();
+    if (!conn) return "";
+
+    try {
+        unique_ptr<sql::Statement> stmt(conn->createStatement());
+        unique_ptr<sql::ResultSet> res(stmt->executeQuery(
+            "SELECT COUNT(*) AS row_count, COALESCE(MAX(id), 0) AS max_id, "
+            "COALESCE(SUM(CRC32(CONCAT_WS('|', id, keyword, category))), 0) AS checksum "
+            "FROM privacy_keywords"
+        ));
+        if (res->next()) {
+            string rowCount = res->getString("row_count");
+            string maxId = res->getString("max_id");
+            string checksum = res->getString("checksum");
+            return rowCount + ":" + maxId + ":" + checksum;
+        }
+    } catch (sql::SQLException &e) {
+        noteError(conn, e);
+        cerr << "SQL Error checking keyword version: " << e.what() << endl;
+    }
+
+    return "";
+}
+
+void DatabaseManager::setCompression(bool enabled) {
+    compressionEnabled = enabled;
+}
+
+void DatabaseManager::setMultiRowInserts(bool enabled) {
+    multiRowInserts = enabled;
+}
+
 string DatabaseManager::getLastError() const {
     return lastError;
 }
\ No newline at end of file
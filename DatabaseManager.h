@@ -5,70 +5,117 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <memory>
 #include <stdexcept>
+#include <cstdint>
 #include <cppconn/driver.h>
 #include <cppconn/connection.h>
 #include <cppconn/resultset.h>
 #include <cppconn/statement.h>
 #include <cppconn/prepared_statement.h>
+#include <cppconn/exception.h>
+#include "ConnectionPool.h"
+#include "ContentCodec.h"
+#include "PolicyStore.h"
 
 using namespace std;
 
-// Structure to store policy information
-struct PolicyRecord {
-    int id;
-    string content;
-    string source; // "file" or "manual"
-    string filename; // if from file
-    size_t char_count;
-    string analysis_date;
-};
-
-// Structure to store analysis results
-struct AnalysisResult {
-    int policy_id;
-    string keyword_analysis;
-    string ai_summary;
-    string analysis_date;
-};
-
-class DatabaseManager {
+// MySQL implementation of PolicyStore (see PolicyStore.h for the contract)
+class DatabaseManager : public PolicyStore {
 protected:
     string host, user, password, schema;
     unsigned int port;
-    sql::Driver *driver;
-    unique_ptr<sql::Connection> conn;
+    shared_ptr<ConnectionPool> pool; // shared by every manager with the same credentials
     string lastError;
+    bool compressionEnabled; // compress policy content on insert
+    bool multiRowInserts;    // storePolicyBatch sends many rows per INSERT
 
-public:
-    // Default constructor
-    DatabaseManager();
+    void initPool();
+
+    // Check a connection out for one operation; empty (and lastError set)
+    // if the pool could not provide one in time
+    PooledConnection borrow();
+
+    // Record a query error; connections the server dropped are discarded
+    void noteError(PooledConnection &conn, sql::SQLException &e);
+
+    // AUTO_INCREMENT id generated by the last INSERT on this connection
+    int lastInsertId(PooledConnection &conn);
+
+    // Policy text from a row selecting content, content_blob and content_codec
+    string readContent(sql::ResultSet &res, size_t char_count);
+
+    // Ids of a multi-row INSERT into table that just ran on conn, in row
+    // order; false unless column holds the expected value in every row
+    bool insertedIds(PooledConnection &conn, const string &table, const string &column,
+                     const vector<uint64_t> &expected, vector<int> &ids);
 
-    // Parameterized constructor
+    // The policy and analysis INSERTs of storePolicyBatch. multiRow sends
+    // each table as one statement and returns false if the ids it was
+    // given cannot be confirmed; otherwise rows go one at a time.
+    bool writeBatch(PooledConnection &conn, const vector<PolicyWrite>& rows, const vector<size_t>& inserted,
+                    const vector<size_t>& analyzed, const vector<uint64_t>& hashes,
+                    const vector<EncodedContent>& encoded, bool multiRow,
+                    vector<int>& policy_ids, vector<int>& analysis_ids);
+
+    // Count rows for analyses just inserted on conn, as (analysis id, counts)
+    void insertCounts(PooledConnection &conn, const vector<pair<int, const AnalysisCounts*>>& analyses);
+
+public:
+    // Credentials come from the store spec or the environment (see openStore)
     DatabaseManager(string h, string u, string p, string s, unsigned int prt = 3306);
 
     // Virtual destructor for inheritance safety
     virtual ~DatabaseManager();
 
     // Virtual methods (can be overridden)
-    virtual bool connect();
-    virtual void close();
-    virtual vector<pair<string, string>> getKeywords();
+    // Operations borrow a pooled connection per call; connect() only opens
+    // the pool's minimum connections up front
+    bool connect() override;
+    void close() override;
+
+    // The MySQL client library needs these on every thread that queries
+    void threadInit() override;
+    void threadEnd() override;
+    vector<pair<string, string>> getKeywords() override;
+
+    // Row count, max id and checksum of privacy_keywords
+    string getKeywordsVersion() override;
+
+    // Versions are recorded in schema_version
+    bool migrateSchema() override;
+    static int latestSchemaVersion();
     
     // New methods for policy storage
-    virtual bool storePolicy(const string& content, const string& source, const string& filename = "");
-    virtual vector<PolicyRecord> getStoredPolicies();
-    virtual bool createPolicyTable(); // Create table if not exists
+    // content is streamed to the server as-is; with compression on, larger
+    // texts are stored zlib-compressed instead
+    int storePolicy(string_view content, const string& source, const string& filename = "", uint64_t hash = 0) override;
+    vector<PolicyRecord> getStoredPolicies() override;
+    bool forEachPolicy(const function<bool(const PolicyRecord&)>& visit, int batchSize = 100) override;
+
+    // One multi-row INSERT per table in a single transaction
+    bool storePolicyBatch(const vector<PolicyWrite>& rows, vector<int>& policy_ids) override;
+
+    vector<PolicySummary> listPolicies(int beforeId, int limit) override;
+    int getLatestPolicyId() override;
+    int findPolicyByHash(uint64_t hash, size_t char_count) override;
 
     // New methods for analysis storage
-    virtual bool storeAnalysisResults(int policy_id, const string& keyword_analysis, const string& ai_summary = "");
-    virtual vector<AnalysisResult> getAnalysisResults(int policy_id);
-    virtual bool createAnalysisTable(); // Create analysis table if not exists
+    bool storeAnalysisResults(int policy_id, const string& keyword_analysis, const string& ai_summary = "",
+                              const AnalysisCounts& counts = AnalysisCounts()) override;
+    vector<AnalysisResult> getAnalysisResults(int policy_id) override;
+    bool forEachAnalysis(int policy_id, const function<bool(const AnalysisResult&)>& visit, int batchSize = 100) override;
+    bool getLatestAnalysis(int policy_id, AnalysisResult& result) override;
+    bool getAnalysisCounts(int analysis_id, AnalysisCounts& counts) override;
+    vector<CoverageStat> getCoverage(bool byKeyword = false) override;
+
+    void setCompression(bool enabled) override;
+    void setMultiRowInserts(bool enabled) override;
 
     // Getter for error messages
-    string getLastError() const;
+    string getLastError() const override;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,195 @@
+// ExcerptSelector.cpp
+#include "ExcerptSelector.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+// Hits past this many in one sentence add nothing to its score
+static const size_t MAX_SCORED_HITS = 5;
+
+static bool isSpace(char c) {
+    return isspace((unsigned char)c) != 0;
+}
+
+// Add value to a sorted vector unless it is already there
+static void insertUnique(vector<uint32_t>& values, uint32_t value) {
+    auto it = lower_bound(values.begin(), values.end(), value);
+    if (it == values.end() || *it != value) {
+        values.insert(it, value);
+    }
+}
+
+ExcerptSelector::ExcerptSelector(size_t budget, size_t maxSentence)
+    : tokenBudget(budget), maxSentenceChars(max<size_t>(maxSentence, 80)) {
+}
+
+size_t ExcerptSelector::estimateTokens(size_t characters) {
+    return (characters + 3) / 4;
+}
+
+vector<pair<size_t, size_t>> ExcerptSelector::splitSentences(string_view text) {
+    vector<pair<size_t, size_t>> sentences;
+    const size_t length = text.size();
+
+    auto push = [&](size_t begin, size_t end) {
+        while (begin < end && isSpace(text[begin])) begin++;
+        while (end > begin && isSpace(text[end - 1])) end--;
+        if (begin < end) sentences.emplace_back(begin, end);
+    };
+
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        if ((c == '.' || c == '!' || c == '?') && (i + 1 == length || isSpace(text[i + 1]))) {
+            push(start, i + 1);
+            start = i + 1;
+        } else if (c == '\n') {
+            // A blank line ends a heading or list item that has no punctuation
+            size_t next = i + 1;
+            if (next < length && text[next] == '\r') next++;
+            if (next < length && text[next] == '\n') {
+                push(start, i);
+                start = next + 1;
+                i = next;
+            }
+        }
+    }
+    push(start, length);
+    return sentences;
+}
+
+string ExcerptSelector::sentenceText(string_view text, const Sentence& sentence) const {
+    size_t begin = sentence.begin;
+    size_t end = sentence.end;
+    bool clippedFront = false;
+    bool clippedBack = false;
+
+    if (end - begin > maxSentenceChars) {
+        // Keep some lead-in before the first hit, then fill to the limit
+        size_t lead = maxSentenceChars / 4;
+        if (sentence.firstHit > begin + lead) {
+            begin = sentence.firstHit - lead;
+            while (begin < sentence.firstHit && !isSpace(text[begin - 1])) begin++;
+            clippedFront = true;
+        }
+        if (end - begin > maxSentenceChars) {
+            end = begin + maxSentenceChars;
+            while (end > sentence.firstHit + 1 && !isSpace(text[end])) end--;
+            clippedBack = true;
+        }
+    }
+
+    // Line breaks and indentation inside a sentence only cost tokens
+    string out;
+    out.reserve(end - begin + 6);
+    if (clippedFront) out += "...";
+    bool pendingSpace = false;
+    for (size_t i = begin; i < end; i++) {
+        if (isSpace(text[i])) {
+            pendingSpace = !out.empty();
+            continue;
+        }
+        if (pendingSpace) out += ' ';
+        pendingSpace = false;
+        out += text[i];
+    }
+    if (clippedBack) out += "...";
+    return out;
+}
+
+Excerpt ExcerptSelector::select(string_view text, const MatchResult& result) const {
+    Excerpt excerpt;
+    if (result.hits.empty()) return excerpt;
+
+    vector<pair<size_t, size_t>> bounds = splitSentences(text);
+
+    // Hits and sentences are both in offset order, so one pass assigns them
+    vector<Sentence> sentences;
+    vector<size_t> position; // index into bounds for each entry of sentences
+    size_t h = 0;
+    for (size_t s = 0; s < bounds.size(); s++) {
+        Sentence sentence{bounds[s].first, bounds[s].second, 0, 0, {}, {}};
+        while (h < result.hits.size() && result.hits[h].begin < sentence.begin) h++;
+        for (; h < result.hits.size() && result.hits[h].begin < sentence.end; h++) {
+            const MatchHit& hit = result.hits[h];
+            if (sentence.hitCount == 0) sentence.firstHit = hit.begin;
+            sentence.hitCount++;
+            insertUnique(sentence.categories, hit.categoryId);
+            insertUnique(sentence.keywords, hit.keywordId);
+        }
+        if (sentence.hitCount > 0) {
+            sentences.push_back(move(sentence));
+            position.push_back(s);
+        }
+    }
+    excerpt.candidates = sentences.size();
+    if (sentences.empty()) return excerpt;
+
+    vector<string> texts;
+    vector<size_t> costs;
+    texts.reserve(sentences.size());
+    costs.reserve(sentences.size());
+    for (const auto& sentence : sentences) {
+        texts.push_back(sentenceText(text, sentence));
+        costs.push_back(estimateTokens(texts.back().size() + 1)); // + separator
+    }
+
+    // Greedy weighted coverage: each pick favours categories the excerpt does
+    // not mention yet, then unseen keywords, then hit density, per token
+    vector<size_t> categoryTaken(result.categoryCounts.size(), 0);
+    vector<bool> keywordTaken(result.keywordCounts.size(), false);
+    vector<bool> chosen(sentences.size(), false);
+    size_t remaining = tokenBudget;
+
+    while (true) {
+        size_t best = sentences.size();
+        double bestScore = 0.0;
+        for (size_t i = 0; i < sentences.size(); i++) {
+            if (chosen[i] || costs[i] > remaining) continue;
+
+            const Sentence& sentence = sentences[i];
+            double gain = 0.0;
+            for (uint32_t c : sentence.categories) {
+                size_t taken = c < categoryTaken.size() ? categoryTaken[c] : 0;
+                gain += 1.0 / (1.0 + taken);
+            }
+            for (uint32_t k : sentence.keywords) {
+                if (k >= keywordTaken.size() || !keywordTaken[k]) gain += 0.5;
+            }
+            gain += 0.1 * min(sentence.hitCount, MAX_SCORED_HITS);
+
+            double score = gain / sqrt((double)costs[i]);
+            if (score > bestScore) { // strict, so ties go to the earlier sentence
+                bestScore = score;
+                best = i;
+            }
+        }
+        if (best == sentences.size()) break;
+
+        chosen[best] = true;
+        remaining -= costs[best];
+        for (uint32_t c : sentences[best].categories) {
+            if (c < categoryTaken.size()) categoryTaken[c]++;
+        }
+        for (uint32_t k : sentences[best].keywords) {
+            if (k < keywordTaken.size()) keywordTaken[k] = true;
+        }
+    }
+
+    // Document order reads better than score order; mark the gaps
+    size_t previous = 0;
+    for (size_t i = 0; i < sentences.size(); i++) {
+        if (!chosen[i]) continue;
+        if (!excerpt.text.empty()) {
+            excerpt.text += position[i] == previous + 1 ? " " : " ... ";
+        }
+        excerpt.text += texts[i];
+        previous = position[i];
+        excerpt.sentences++;
+    }
+    for (size_t taken : categoryTaken) {
+        if (taken > 0) excerpt.categoriesCovered++;
+    }
+    excerpt.estimatedTokens = estimateTokens(excerpt.text.size());
+    return excerpt;
+}
@@ -0,0 +1,58 @@
+// ExcerptSelector.h
+#ifndef EXCERPTSELECTOR_H
+#define EXCERPTSELECTOR_H
+
+#include "KeywordMatcher.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Sentences picked for a prompt, joined in document order
+struct Excerpt {
+    string text;                   // empty if the result had no hits
+    size_t sentences = 0;          // sentences included
+    size_t candidates = 0;         // sentences with at least one hit
+    size_t estimatedTokens = 0;
+    size_t categoriesCovered = 0;
+};
+
+// Keyword-guided extractive compression of a policy for the LLM. Rather
+// than the first N characters, the prompt gets the sentences that contain
+// keyword hits. Sentences are ranked by the categories and keywords they
+// mention, where a category already represented in the excerpt counts for
+// less each time, and added greedily until the token budget is spent.
+class ExcerptSelector {
+private:
+    size_t tokenBudget;
+    size_t maxSentenceChars; // longer sentences are clipped around their first hit
+
+    // One sentence of the text and the hits inside it
+    struct Sentence {
+        size_t begin;
+        size_t end;
+        size_t firstHit;          // offset of the first hit
+        size_t hitCount;
+        vector<uint32_t> categories; // distinct, ascending
+        vector<uint32_t> keywords;   // distinct, ascending
+    };
+
+    // [begin, end) of each sentence, surrounding whitespace trimmed. A
+    // sentence ends at . ! or ? followed by whitespace, or at a blank line.
+    static vector<pair<size_t, size_t>> splitSentences(string_view text);
+
+    // Sentence text, clipped to maxSentenceChars around its first hit
+    string sentenceText(string_view text, const Sentence& sentence) const;
+
+public:
+    explicit ExcerptSelector(size_t budget = 384, size_t maxSentence = 600);
+
+    // result must come from matching exactly this text with hits recorded
+    Excerpt select(string_view text, const MatchResult& result) const;
+
+    // Rough token count for English prose (about four characters a token)
+    static size_t estimateTokens(size_t characters);
+};
+
+#endif
@@ -0,0 +1,274 @@
+// KeywordAutomaton.cpp
+#include "KeywordAutomaton.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <queue>
+#include <thread>
+
+// Chunks smaller than this are not worth a thread hand-off
+static const size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+// Same character set as the regex "\b" assertion
+static bool isWordChar(unsigned char c) {
+    return isalnum(c) || c == '_';
+}
+
+// True if a proper prefix of pattern equals a suffix, ignoring case
+static bool hasBorder(const string& pattern) {
+    for (size_t shift = 1; shift < pattern.size(); shift++) {
+        bool border = true;
+        for (size_t i = shift; i < pattern.size() && border; i++) {
+            border = tolower((unsigned char)pattern[i]) == tolower((unsigned char)pattern[i - shift]);
+        }
+        if (border) return true;
+    }
+    return false;
+}
+
+KeywordAutomaton::KeywordAutomaton() : classCount(1), longestPattern(0) {
+    for (int i = 0; i < 256; i++) charClass[i] = 0;
+}
+
+void KeywordAutomaton::build(const vector<string>& patterns) {
+    for (int i = 0; i < 256; i++) charClass[i] = 0;
+    classCount = 1;
+    transitions.clear();
+    outputs.clear();
+    outputLink.clear();
+    patternLengths.assign(patterns.size(), 0);
+    patternStartsWord.assign(patterns.size(), false);
+    patternEndsWord.assign(patterns.size(), false);
+    patternSelfOverlaps.assign(patterns.size(), false);
+    longestPattern = 0;
+
+    // Compress the alphabet to the letters that actually occur in keywords,
+    // folding upper and lower case into one class
+    for (const auto& pattern : patterns) {
+        for (unsigned char c : pattern) {
+            unsigned char lower = (unsigned char)tolower(c);
+            if (charClass[lower] == 0) {
+                charClass[lower] = (unsigned char)classCount++;
+            }
+        }
+    }
+    for (int c = 0; c < 256; c++) {
+        unsigned char lower = (unsigned char)tolower(c);
+        charClass[c] = charClass[lower];
+    }
+
+    // Build the keyword trie
+    transitions.assign(classCount, -1);
+    outputs.resize(1);
+    for (size_t p = 0; p < patterns.size(); p++) {
+        const string& pattern = patterns[p];
+        if (pattern.empty()) continue;
+
+        int node = 0;
+        for (unsigned char c : pattern) {
+            size_t slot = node * classCount + charClass[c];
+            if (transitions[slot] == -1) {
+                transitions[slot] = (int)outputs.size();
+                outputs.emplace_back();
+                transitions.resize(outputs.size() * classCount, -1);
+            }
+            node = transitions[slot];
+        }
+        outputs[node].push_back(p);
+        patternLengths[p] = pattern.size();
+        patternStartsWord[p] = isWordChar(pattern.front());
+        patternEndsWord[p] = isWordChar(pattern.back());
+        patternSelfOverlaps[p] = hasBorder(pattern);
+        longestPattern = max(longestPattern, pattern.size());
+    }
+
+    // Breadth-first pass turns the trie into a full DFA: missing edges
+    // follow the failure link, and output links chain shorter suffix matches
+    vector<int> failure(outputs.size(), 0);
+    outputLink.assign(outputs.size(), -1);
+    queue<int> pending;
+    for (size_t c = 0; c < classCount; c++) {
+        int &next = transitions[c];
+        if (next == -1) {
+            next = 0;
+        } else {
+            pending.push(next);
+        }
+    }
+
+    while (!pending.empty()) {
+        int node = pending.front();
+        pending.pop();
+        for (size_t c = 0; c < classCount; c++) {
+            int &next = transitions[node * classCount + c];
+            int fallback = transitions[failure[node] * classCount + c];
+            if (next == -1) {
+                next = fallback;
+                continue;
+            }
+            failure[next] = fallback;
+            outputLink[next] = outputs[fallback].empty() ? outputLink[fallback] : fallback;
+            pending.push(next);
+        }
+    }
+}
+
+bool KeywordAutomaton::empty() const {
+    return outputs.size() <= 1;
+}
+
+size_t KeywordAutomaton::maxPatternLength() const {
+    return longestPattern;
+}
+
+void KeywordAutomaton::scanRange(string_view text, size_t from, size_t to, vector<KeywordHit>& hits) const {
+    const size_t length = text.size();
+    const size_t stop = min(length, to + longestPattern - 1);
+    int node = 0;
+
+    for (size_t i = from; i < stop; i++) {
+        node = transitions[node * classCount + charClass[(unsigned char)text[i]]];
+
+        int match = outputs[node].empty() ? outputLink[node] : node;
+        if (match == -1) continue;
+
+        size_t end = i + 1;
+        bool nextIsWord = end < length && isWordChar(text[end]);
+        for (; match != -1; match = outputLink[match]) {
+            for (size_t p : outputs[match]) {
+                size_t begin = end - patternLengths[p];
+                if (begin >= to) continue;
+                bool prevIsWord = begin > 0 && isWordChar(text[begin - 1]);
+                if (prevIsWord == patternStartsWord[p]) continue;
+                if (nextIsWord == patternEndsWord[p]) continue;
+
+                hits.push_back({p, begin, patternLengths[p]});
+            }
+        }
+    }
+}
+
+void KeywordAutomaton::dropOverlapping(vector<KeywordHit>& hits) const {
+    // Each pattern's hits arrive in increasing offset order, so keeping the
+    // leftmost one and skipping anything that starts before its end matches
+    // repeated regex_search. Only patterns with a border can overlap at all.
+    vector<size_t> lastEnd(patternLengths.size(), 0);
+    size_t kept = 0;
+    for (const auto& hit : hits) {
+        if (patternSelfOverlaps[hit.pattern]) {
+            if (hit.begin < lastEnd[hit.pattern]) continue;
+            lastEnd[hit.pattern] = hit.begin + hit.length;
+        }
+        hits[kept++] = hit;
+    }
+    hits.resize(kept);
+}
+
+vector<KeywordHit> KeywordAutomaton::findAll(string_view text) const {
+    vector<KeywordHit> hits;
+    if (empty()) return hits;
+
+    scanRange(text, 0, text.size(), hits);
+    dropOverlapping(hits);
+    return hits;
+}
+
+vector<KeywordHit> KeywordAutomaton::findAllParallel(string_view text, unsigned threads) const {
+    if (threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+
+    // A few chunks per thread keeps workers busy when hit density is uneven
+    size_t chunkCount = min<size_t>(threads * 4, text.size() / MIN_CHUNK_SIZE);
+    if (empty() || threads == 1 || chunkCount < 2) {
+        return findAll(text);
+    }
+
+    size_t chunkSize = (text.size() + chunkCount - 1) / chunkCount;
+    vector<vector<KeywordHit>> chunkHits(chunkCount);
+    atomic<size_t> nextChunk(0);
+
+    auto worker = [&]() {
+        for (size_t c = nextChunk++; c < chunkCount; c = nextChunk++) {
+            size_t from = c * chunkSize;
+            size_t to = min(text.size(), from + chunkSize);
+            scanRange(text, from, to, chunkHits[c]);
+        }
+    };
+
+    vector<thread> pool;
+    unsigned workers = (unsigned)min<size_t>(threads, chunkCount);
+    for (unsigned t = 0; t < workers; t++) {
+        pool.emplace_back(worker);
+    }
+    for (auto& t : pool) {
+        t.join();
+    }
+
+    // Merge in chunk order so the result never depends on thread timing
+    vector<KeywordHit> hits;
+    size_t total = 0;
+    for (const auto& chunk : chunkHits) total += chunk.size();
+    hits.reserve(total);
+    for (const auto& chunk : chunkHits) {
+        hits.insert(hits.end(), chunk.begin(), chunk.end());
+    }
+    dropOverlapping(hits);
+    return hits;
+}
+
+KeywordStream::KeywordStream(const KeywordAutomaton& automaton)
+    : automaton(automaton), node(0), offset(0),
+      recentIsWord(automaton.longestPattern + 1, false),
+      lastEnd(automaton.patternLengths.size(), 0) {
+}
+
+void KeywordStream::resolvePending(bool nextIsWord, vector<KeywordHit>& hits) {
+    for (const auto& hit : pending) {
+        if (nextIsWord == automaton.patternEndsWord[hit.pattern]) continue;
+        if (hit.begin < lastEnd[hit.pattern]) continue;
+
+        lastEnd[hit.pattern] = hit.begin + hit.length;
+        hits.push_back(hit);
+    }
+    pending.clear();
+}
+
+void KeywordStream::feed(const char* data, size_t size, vector<KeywordHit>& hits) {
+    if (automaton.empty()) {
+        offset += size;
+        return;
+    }
+
+    const size_t window = recentIsWord.size();
+    for (size_t i = 0; i < size; i++) {
+        unsigned char c = (unsigned char)data[i];
+        bool isWord = isWordChar(c);
+        if (!pending.empty()) {
+            resolvePending(isWord, hits);
+        }
+
+        recentIsWord[offset % window] = isWord;
+        node = automaton.transitions[node * automaton.classCount + automaton.charClass[c]];
+        offset++;
+
+        int match = automaton.outputs[node].empty() ? automaton.outputLink[node] : node;
+        for (; match != -1; match = automaton.outputLink[match]) {
+            for (size_t p : automaton.outputs[match]) {
+                size_t begin = offset - automaton.patternLengths[p];
+                bool prevIsWord = begin > 0 && recentIsWord[(begin - 1) % window];
+                if (prevIsWord == automaton.patternStartsWord[p]) continue;
+
+                pending.push_back({p, begin, automaton.patternLengths[p]});
+            }
+        }
+    }
+}
+
+void KeywordStream::finish(vector<KeywordHit>& hits) {
+    resolvePending(false, hits);
+}
+
+size_t KeywordStream::consumed() const {
+    return offset;
+}
@@ -0,0 +1,93 @@
+// KeywordAutomaton.h
+#ifndef KEYWORDAUTOMATON_H
+#define KEYWORDAUTOMATON_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Single keyword occurrence found in the scanned text
+struct KeywordHit {
+    size_t pattern; // index into the pattern list given to build()
+    size_t begin;   // byte offset of the first matched character
+    size_t length;  // matched length in bytes
+};
+
+class KeywordStream;
+
+// Aho-Corasick automaton over a fixed keyword list.
+// Matching is ASCII case-insensitive and only reports occurrences that sit
+// on word boundaries, mirroring the old "\\b" + keyword + "\\b" regex.
+class KeywordAutomaton {
+    friend class KeywordStream;
+
+private:
+    unsigned char charClass[256]; // byte -> alphabet class (0 = not in any keyword)
+    size_t classCount;
+    vector<int> transitions;      // node * classCount + class -> next node
+    vector<vector<size_t>> outputs; // patterns ending at each node
+    vector<int> outputLink;       // nearest suffix node that has outputs, -1 if none
+    vector<size_t> patternLengths;
+    vector<bool> patternStartsWord;
+    vector<bool> patternEndsWord;
+    vector<bool> patternSelfOverlaps; // two occurrences can overlap (pattern has a border)
+    size_t longestPattern;
+
+    // Raw hits whose first character lies in [from, to); reads past `to`
+    // by at most longestPattern - 1 bytes to finish them
+    void scanRange(string_view text, size_t from, size_t to, vector<KeywordHit>& hits) const;
+
+    // Drop hits that overlap an earlier hit of the same pattern
+    void dropOverlapping(vector<KeywordHit>& hits) const;
+
+public:
+    KeywordAutomaton();
+
+    // Compile the automaton; empty patterns are ignored
+    void build(const vector<string>& patterns);
+
+    bool empty() const;
+
+    size_t maxPatternLength() const;
+
+    // One left-to-right pass over text. Each pattern's hits are
+    // non-overlapping, as successive regex_search calls would report them.
+    vector<KeywordHit> findAll(string_view text) const;
+
+    // Same hits as findAll, computed by splitting text into chunks that
+    // overlap by the longest pattern and scanning them on worker threads.
+    // threads == 0 uses every hardware thread.
+    vector<KeywordHit> findAllParallel(string_view text, unsigned threads = 0) const;
+};
+
+// Incremental matcher for text that arrives in pieces. Carries the automaton
+// state, the word-ness of the last few characters and hits still waiting for
+// their trailing boundary, so memory stays bounded by the longest keyword
+// regardless of input size. Hit offsets are relative to the whole stream.
+class KeywordStream {
+private:
+    const KeywordAutomaton& automaton;
+    int node;
+    size_t offset;                 // characters consumed so far
+    vector<bool> recentIsWord;     // ring buffer indexed by offset % size
+    vector<KeywordHit> pending;    // hits ending at offset, boundary not yet known
+    vector<size_t> lastEnd;        // per pattern, for non-overlapping hits
+
+    // Accept pending hits now that the character after them is known
+    void resolvePending(bool nextIsWord, vector<KeywordHit>& hits);
+
+public:
+    explicit KeywordStream(const KeywordAutomaton& automaton);
+
+    // Consume the next piece of text; completed hits are appended to hits
+    void feed(const char* data, size_t size, vector<KeywordHit>& hits);
+
+    // End of input: flush hits that ended on the last character
+    void finish(vector<KeywordHit>& hits);
+
+    size_t consumed() const;
+};
+
+#endif
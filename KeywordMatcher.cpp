@@ -1,129 +1,302 @@
 // KeywordMatcher.cpp
 #include "KeywordMatcher.h"
-#include <regex>
+#include <algorithm>
+#include <istream>
 #include <sstream>
 #define RESET   "\033[0m"
 #define RED     "\033[31m"
 #define YELLOW  "\033[33m"
 #define GREEN   "\033[32m"
 
-KeywordMatcher::KeywordMatcher() : DatabaseManager() {
+KeywordMatcher::KeywordMatcher() : matchThreads(0), recordOffsets(true), quiet(false) {
     cout << "[KeywordMatcher] Ready to match privacy policy text.\n";
 }
 
-bool KeywordMatcher::loadKeywords() {
-    if (!connect()) {
-        cerr << "[KeywordMatcher] Could not connect to DB. Error: " << getLastError() << endl;
-        return false;
+bool KeywordMatcher::loadKeywords(PolicyStore &store) {
+    string version = store.getKeywordsVersion();
+    if (version.empty() && !keywordList.empty()) {
+        cerr << "[KeywordMatcher] Could not check keywords (" << store.getLastError() << "), using cached set.\n";
+        return true;
+    }
+
+    if (!keywordList.empty() && !version.empty() && version == keywordVersion) {
+        cout << "[KeywordMatcher] Keywords unchanged, using cached set of " << keywordList.size() << ".\n";
+        return true;
     }
 
-    keywordList = DatabaseManager::getKeywords();
+    keywordList = store.getKeywords();
     if (keywordList.empty()) {
         cerr << "[KeywordMatcher] No keywords found in DB.\n";
+        keywordVersion.clear();
         return false;
     }
 
+    keywordVersion = version;
+    compileKeywords();
+
     cout << "[KeywordMatcher] Loaded " << keywordList.size() << " keywords from DB.\n";
     return true;
 }
 
-void KeywordMatcher::findMatches(const string &text) {
+void KeywordMatcher::compileKeywords() {
+    keywordNames.clear();
+    categoryNames.clear();
+    for (const auto &pair : keywordList) {
+        keywordNames.push_back(pair.first);
+        categoryNames.push_back(pair.second);
+    }
+    sort(keywordNames.begin(), keywordNames.end());
+    keywordNames.erase(unique(keywordNames.begin(), keywordNames.end()), keywordNames.end());
+    sort(categoryNames.begin(), categoryNames.end());
+    categoryNames.erase(unique(categoryNames.begin(), categoryNames.end()), categoryNames.end());
+
+    auto idOf = [](const vector<string> &names, const string &name) {
+        return (uint32_t)(lower_bound(names.begin(), names.end(), name) - names.begin());
+    };
+
+    rowIds.clear();
+    categoryKeywords.assign(categoryNames.size(), {});
+    for (const auto &pair : keywordList) {
+        uint32_t keywordId = idOf(keywordNames, pair.first);
+        uint32_t categoryId = idOf(categoryNames, pair.second);
+        rowIds.push_back(make_pair(keywordId, categoryId));
+        categoryKeywords[categoryId].push_back(make_pair(keywordId, (size_t)1));
+    }
+
+    // Duplicate rows of the same pair count every hit once per row
+    keywordCategories.assign(keywordNames.size(), {});
+    for (uint32_t c = 0; c < categoryKeywords.size(); c++) {
+        auto &keywords = categoryKeywords[c];
+        sort(keywords.begin(), keywords.end());
+        size_t kept = 0;
+        for (const auto &entry : keywords) {
+            if (kept > 0 && keywords[kept - 1].first == entry.first) {
+                keywords[kept - 1].second++;
+            } else {
+                keywords[kept++] = entry;
+            }
+        }
+        keywords.resize(kept);
+
+        for (const auto &entry : keywords) {
+            keywordCategories[entry.first].push_back(make_pair(c, entry.second));
+        }
+    }
+
+    automaton.build(keywordNames);
+    lastResult = emptyResult();
+}
+
+MatchResult KeywordMatcher::emptyResult() const {
+    MatchResult result;
+    result.keywordCounts.assign(keywordNames.size(), 0);
+    result.categoryCounts.assign(categoryNames.size(), 0);
+    return result;
+}
+
+void KeywordMatcher::addHits(const vector<KeywordHit> &found, MatchResult &result, bool withHits) const {
+    for (const auto &hit : found) {
+        result.keywordCounts[hit.pattern]++;
+        if (!withHits) continue;
+
+        for (const auto &category : keywordCategories[hit.pattern]) {
+            result.hits.push_back({(uint32_t)hit.pattern, category.first, hit.begin, (uint32_t)hit.length});
+        }
+    }
+}
+
+void KeywordMatcher::finishResult(MatchResult &result) const {
+    for (uint32_t k = 0; k < keywordCategories.size(); k++) {
+        if (result.keywordCounts[k] == 0) continue;
+        for (const auto &category : keywordCategories[k]) {
+            result.categoryCounts[category.first] += result.keywordCounts[k] * category.second;
+        }
+    }
+
+    // The automaton reports in end order (per chunk when parallel); sort so
+    // every path yields the same sequence
+    sort(result.hits.begin(), result.hits.end(), [](const MatchHit &a, const MatchHit &b) {
+        if (a.begin != b.begin) return a.begin < b.begin;
+        if (a.keywordId != b.keywordId) return a.keywordId < b.keywordId;
+        return a.categoryId < b.categoryId;
+    });
+}
+
+MatchResult KeywordMatcher::match(string_view text, bool withHits) const {
+    MatchResult result = emptyResult();
+
+    // Single pass over the text (chunked across cores when it is large)
+    addHits(automaton.findAllParallel(text, matchThreads), result, withHits);
+    finishResult(result);
+    return result;
+}
+
+bool KeywordMatcher::matchStream(istream &in, MatchResult &result, bool withHits, size_t bufferSize) const {
+    result = emptyResult();
+
+    KeywordStream stream(automaton);
+    vector<char> buffer(bufferSize);
+    vector<KeywordHit> found;
+
+    while (in) {
+        in.read(buffer.data(), buffer.size());
+        stream.feed(buffer.data(), (size_t)in.gcount(), found);
+        addHits(found, result, withHits);
+        found.clear();
+    }
+    if (in.bad()) {
+        cerr << "[KeywordMatcher] Read error after " << stream.consumed() << " characters.\n";
+        return false;
+    }
+
+    stream.finish(found);
+    addHits(found, result, withHits);
+    finishResult(result);
+    return true;
+}
+
+void KeywordMatcher::findMatches(string_view text) {
     if (keywordList.empty()) {
         cerr << "[KeywordMatcher] No keywords loaded.\n";
         return;
     }
 
-    // Clear previous matches
-    categoryCount.clear();
-    matchedKeywordsByCategory.clear();
+    lastResult = match(text, recordOffsets);
+    printHighlights(lastResult);
+}
+
+bool KeywordMatcher::findMatchesInStream(istream &in, size_t bufferSize) {
+    if (keywordList.empty()) {
+        cerr << "[KeywordMatcher] No keywords loaded.\n";
+        return false;
+    }
+
+    if (!matchStream(in, lastResult, recordOffsets, bufferSize)) {
+        lastResult = emptyResult();
+        return false;
+    }
+    printHighlights(lastResult);
+    return true;
+}
+
+void KeywordMatcher::printHighlights(const MatchResult &result) const {
+    if (quiet) return;
 
     cout << "\n  Analyzing Privacy Policy Text...\n";
     cout << "------------------------------------\n";
 
-    for (auto &pair : keywordList) {
-        string keyword = pair.first;
-        string category = pair.second;
-
-        // Case-insensitive regex search
-        regex wordRegex("\\b" + keyword + "\\b", regex_constants::icase);
-        smatch match;
-
-        string::const_iterator searchStart(text.cbegin());
-        bool found = false;
-
-        while (regex_search(searchStart, text.cend(), match, wordRegex)) {
-            found = true;
-            searchStart = match.suffix().first;
-            categoryCount[category]++;
-            
-            // Store the matched keyword
-            matchedKeywordsByCategory[category].push_back(keyword);
-
-            if (category == "Data Collection")
-                cout << RED << "[" << keyword << "]" << RESET << " ";
-            else if (category == "Data Sharing")
-                cout << YELLOW << "[" << keyword << "]" << RESET << " ";
-            else
-                cout << GREEN << "[" << keyword << "]" << RESET << " ";
-        }
+    // Report per keyword in table order
+    for (const auto &row : rowIds) {
+        size_t hits = result.keywordCounts[row.first];
+        if (hits == 0) continue;
+
+        const string &keyword = keywordNames[row.first];
+        const string &category = categoryNames[row.second];
+
+        const char *color = GREEN;
+        if (category == "Data Collection")
+            color = RED;
+        else if (category == "Data Sharing")
+            color = YELLOW;
 
-        if (found)
-            cout << " -> (" << category << ")\n";
+        for (size_t n = 0; n < hits; n++) {
+            cout << color << "[" << keyword << "]" << RESET << " ";
+        }
+        cout << " -> (" << category << ")\n";
     }
 }
 
+void KeywordMatcher::setMatchThreads(unsigned threads) {
+    matchThreads = threads;
+}
+
+void KeywordMatcher::setRecordOffsets(bool record) {
+    recordOffsets = record;
+}
+
+void KeywordMatcher::setQuiet(bool enabled) {
+    quiet = enabled;
+}
+
 void KeywordMatcher::showSummary() {
     cout << "\n  Summary of Detected Terms:\n";
     cout << "------------------------------------\n";
 
-    for (auto &entry : categoryCount) {
-        cout << "Category: " << entry.first
-             << " | Occurrences: " << entry.second << endl;
+    const vector<size_t> &categoryCounts = lastResult.categoryCounts;
+    for (size_t c = 0; c < categoryCounts.size(); c++) {
+        if (categoryCounts[c] == 0) continue;
+        cout << "Category: " << categoryNames[c]
+             << " | Occurrences: " << categoryCounts[c] << endl;
     }
 }
 
-map<string, vector<string>> KeywordMatcher::getMatchedKeywords() const {
-    return matchedKeywordsByCategory;
+const vector<string>& KeywordMatcher::getKeywordNames() const {
+    return keywordNames;
+}
+
+const vector<string>& KeywordMatcher::getCategoryNames() const {
+    return categoryNames;
+}
+
+const MatchResult& KeywordMatcher::getLastResult() const {
+    return lastResult;
 }
 
 string KeywordMatcher::getKeywordAnalysis() const {
+    return formatAnalysis(lastResult);
+}
+
+string KeywordMatcher::formatAnalysis(const MatchResult &result) const {
     stringstream analysis;
     
     analysis << "KEYWORD ANALYSIS RESULTS:\n";
     analysis << "=========================\n";
     
-    if (matchedKeywordsByCategory.empty()) {
-        analysis << "No keywords matched in the privacy policy.\n";
-        return analysis.str();
-    }
-    
-    for (const auto& category : matchedKeywordsByCategory) {
-        analysis << "\n" << category.first << ":\n";
-        analysis << "  Occurrences: " << categoryCount.at(category.first) << "\n";
+    bool anyMatch = false;
+    for (size_t c = 0; c < result.categoryCounts.size(); c++) {
+        if (result.categoryCounts[c] == 0) continue;
+        anyMatch = true;
+
+        analysis << "\n" << categoryNames[c] << ":\n";
+        analysis << "  Occurrences: " << result.categoryCounts[c] << "\n";
         analysis << "  Keywords found: ";
         
-        // Remove duplicates and count frequencies
-        map<string, int> keywordFreq;
-        for (const auto& keyword : category.second) {
-            keywordFreq[keyword]++;
-        }
-        
+        // Keyword ids are in name order; rows repeating a pair multiply its count
         bool first = true;
-        for (const auto& kw : keywordFreq) {
+        for (const auto& entry : categoryKeywords[c]) {
+            size_t frequency = result.keywordCounts[entry.first] * entry.second;
+            if (frequency == 0) continue;
+
             if (!first) analysis << ", ";
-            analysis << kw.first;
-            if (kw.second > 1) {
-                analysis << "(" << kw.second << "x)";
+            analysis << keywordNames[entry.first];
+            if (frequency > 1) {
+                analysis << "(" << frequency << "x)";
             }
             first = false;
         }
         analysis << "\n";
     }
+
+    if (!anyMatch) {
+        analysis << "No keywords matched in the privacy policy.\n";
+    }
     
     return analysis.str();
 }
 
-vector<pair<string, string>> KeywordMatcher::getKeywords() {
-    cout << "[KeywordMatcher] Overridden getKeywords() called.\n";
-    return DatabaseManager::getKeywords();
+AnalysisCounts KeywordMatcher::analysisCounts(const MatchResult &result) const {
+    AnalysisCounts counts;
+    counts.counted = true;
+
+    for (size_t c = 0; c < result.categoryCounts.size(); c++) {
+        if (result.categoryCounts[c] == 0) continue;
+        counts.categories.push_back({categoryNames[c], result.categoryCounts[c]});
+
+        for (const auto& entry : categoryKeywords[c]) {
+            size_t frequency = result.keywordCounts[entry.first] * entry.second;
+            if (frequency == 0) continue;
+            counts.keywords.push_back({categoryNames[c], keywordNames[entry.first], frequency});
+        }
+    }
+    return counts;
 }
\ No newline at end of file
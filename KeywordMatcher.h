@@ -2,39 +2,115 @@
 #ifndef KEYWORDMATCHER_H
 #define KEYWORDMATCHER_H
 
-#include "DatabaseManager.h"
-#include <map>
-#include <regex>
+#include "PolicyStore.h"
+#include "KeywordAutomaton.h"
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
 #include <vector>
 
 using namespace std;
 
-class KeywordMatcher : public DatabaseManager {
+// One keyword occurrence, attributed to one of the keyword's categories
+struct MatchHit {
+    uint32_t keywordId;
+    uint32_t categoryId;
+    size_t begin;    // byte offset in the analyzed text
+    uint32_t length; // bytes
+};
+
+// Everything found in one document. Counts are indexed by id; hits are
+// sorted by (begin, keywordId, categoryId) and only filled when requested.
+struct MatchResult {
+    vector<size_t> keywordCounts;
+    vector<size_t> categoryCounts;
+    vector<MatchHit> hits;
+};
+
+class KeywordMatcher {
 private:
     vector<pair<string, string>> keywordList; // from DB
-    map<string, int> categoryCount;           // count matches by category
-    map<string, vector<string>> matchedKeywordsByCategory; // store actual matched keywords
+    string keywordVersion;                    // DB fingerprint keywordList was loaded at
+    unsigned matchThreads;                    // 0 = all cores, 1 = serial
+
+    // Keywords and categories interned to dense ids at load time. Ids follow
+    // sorted name order, so iterating by id gives the report order.
+    vector<string> keywordNames;              // keyword id -> text
+    vector<string> categoryNames;             // category id -> name
+    vector<pair<uint32_t, uint32_t>> rowIds;  // keywordList row -> (keyword id, category id)
+    vector<vector<pair<uint32_t, size_t>>> categoryKeywords; // category id -> (keyword id, rows with that pair)
+    vector<vector<pair<uint32_t, size_t>>> keywordCategories; // keyword id -> (category id, rows with that pair)
+    KeywordAutomaton automaton;               // pattern index == keyword id
+
+    MatchResult lastResult;                   // last document seen by findMatches*
+    bool recordOffsets;
+    bool quiet;
+
+    // Build the id tables and automaton from keywordList
+    void compileKeywords();
+
+    // Empty result sized for the current keyword set
+    MatchResult emptyResult() const;
+
+    // Add a batch of automaton hits to result
+    void addHits(const vector<KeywordHit> &found, MatchResult &result, bool withHits) const;
+
+    // Derive category totals and order hits once all text has been seen
+    void finishResult(MatchResult &result) const;
 
 public:
     KeywordMatcher();
 
-    // Loads keywords using parent class method
-    bool loadKeywords();
+    // Loads keywords from store. Reuses the cached list and automaton while
+    // the keyword table's fingerprint is unchanged.
+    bool loadKeywords(PolicyStore &store);
 
-    // Finds matches in text
-    virtual void findMatches(const string &text);
+    // Match text against the loaded keywords. No console output and no
+    // state change, so one loaded matcher can serve several threads.
+    MatchResult match(string_view text, bool withHits = true) const;
+
+    // Same, reading the stream in bufferSize pieces so the whole text is
+    // never held in memory. Returns false on a read error.
+    bool matchStream(istream &in, MatchResult &result, bool withHits = true, size_t bufferSize = 64 * 1024) const;
+
+    // Finds matches in text, keeps them as the last result and prints
+    // highlights unless quiet
+    virtual void findMatches(string_view text);
+
+    // Streaming variant of findMatches. Returns false on a read error.
+    virtual bool findMatchesInStream(istream &in, size_t bufferSize = 64 * 1024);
+
+    // Worker threads for large texts (0 = all cores, 1 = always serial)
+    void setMatchThreads(unsigned threads);
+
+    // Keep every hit's offset in the last result, not just the counts
+    void setRecordOffsets(bool record);
+
+    // Suppress highlighting and progress output
+    void setQuiet(bool enabled);
+
+    // Console presentation of a result: colored [keyword] per occurrence,
+    // grouped in keyword table order
+    void printHighlights(const MatchResult &result) const;
 
     // Displays category summary
     virtual void showSummary();
 
-    // Get matched keywords for LLM summary
-    map<string, vector<string>> getMatchedKeywords() const;
+    // Interned names for the current keyword set
+    const vector<string>& getKeywordNames() const;
+    const vector<string>& getCategoryNames() const;
+
+    const MatchResult& getLastResult() const;
 
     // Get formatted analysis for LLM
     string getKeywordAnalysis() const;
 
-    // Override getKeywords() for demonstration
-    vector<pair<string, string>> getKeywords() override;
+    // Text report for any result produced by this matcher
+    string formatAnalysis(const MatchResult &result) const;
+
+    // The same totals as formatAnalysis, as rows for the count tables
+    AnalysisCounts analysisCounts(const MatchResult &result) const;
 };
 
 #endif
\ No newline at end of file
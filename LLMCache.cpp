@@ -0,0 +1,392 @@
+// LLMCache.cpp
+#include "LLMCache.h"
+#include "ContentHash.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+static const char MAGIC[] = "LLMCACH2";
+static const char OLD_MAGIC[] = "LLMCACH1"; // no key check; replaced on open
+static const size_t MAGIC_SIZE = 8;
+
+// Seed of the second hash over the key material
+static const uint64_t KEY_CHECK_SEED = 0x9e3779b97f4a7c15ULL;
+
+static const uint8_t RECORD_PUT = 1;
+static const uint8_t RECORD_TOUCH = 2;
+static const uint8_t RECORD_ERASE = 3;
+
+static const size_t RECORD_HEADER = 1 + 8 + 8;       // type, key, stamp
+static const size_t PUT_HEADER = RECORD_HEADER + 8 + 4 + 4; // + key check, length, value check
+
+// Logs smaller than this are never worth rewriting
+static const size_t MIN_COMPACT_BYTES = 64 * 1024;
+
+static void putLE(string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out += (char)(value >> (8 * i));
+    }
+}
+
+static uint64_t getLE(const string& in, size_t pos, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | (unsigned char)in[pos + i];
+    }
+    return value;
+}
+
+// Catches a PUT whose bytes were only partly written
+static uint32_t valueCheck(const string& value) {
+    return (uint32_t)contentHash(value);
+}
+
+static size_t storedSize(const string& value) {
+    return PUT_HEADER + value.size();
+}
+
+// One log record; value and check are only given for PUT
+static string encodeRecord(uint8_t type, uint64_t key, uint64_t stamp, const string* value, uint64_t check = 0) {
+    string record;
+    record.reserve(PUT_HEADER + (value ? value->size() : 0));
+    putLE(record, type, 1);
+    putLE(record, key, 8);
+    putLE(record, stamp, 8);
+    if (value) {
+        putLE(record, check, 8);
+        putLE(record, value->size(), 4);
+        putLE(record, valueCheck(*value), 4);
+        record += *value;
+    }
+    return record;
+}
+
+LLMCache::LLMCache() : maxBytes(0), opened(false), readOnly(false), lockFd(-1), liveBytes(0), fileBytes(0), clock(0) {
+}
+
+LLMCache::~LLMCache() {
+    close();
+}
+
+LLMCacheKey LLMCache::makeKey(string_view model, string_view options, string_view prompt) {
+    string material;
+    material.reserve(model.size() + options.size() + prompt.size() + 24);
+    for (string_view part : {model, options, prompt}) {
+        putLE(material, part.size(), 8);
+        material.append(part.data(), part.size());
+    }
+    return LLMCacheKey{contentHash(material), contentHash(material, KEY_CHECK_SEED)};
+}
+
+bool LLMCache::open(const string& filename, size_t limit) {
+    close();
+    path = filename;
+    maxBytes = limit;
+
+    // Taken before reading, so no other process appends or compacts
+    // between the load and this process's first write
+    string lockPath = path + ".lock";
+    lockFd = ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    readOnly = lockFd < 0 || flock(lockFd, LOCK_EX | LOCK_NB) != 0;
+    if (readOnly) {
+        cout << "[LLMCache] Cache is in use by another process, new replies are kept in memory: " << path << endl;
+    }
+
+    bool damaged = false;
+    if (!load(damaged)) {
+        close();
+        return false;
+    }
+
+    if (readOnly) {
+        // A torn record may just be the owner's write in progress
+        evict();
+        opened = true;
+        return true;
+    }
+
+    // A new file needs its header, and appending after a torn record would
+    // hide everything written later
+    if (fileBytes == 0 || damaged) {
+        compact();
+    }
+    if (!log.is_open()) {
+        log.open(path, ios::binary | ios::app);
+        if (!log) {
+            cerr << "[LLMCache] Could not open cache file for writing: " << path << endl;
+            close();
+            return false;
+        }
+    }
+
+    evict();
+    maybeCompact();
+    opened = true;
+    return true;
+}
+
+void LLMCache::close() {
+    if (log.is_open()) {
+        writeTouches();
+        log.close();
+    }
+    if (lockFd >= 0) {
+        ::close(lockFd); // releases the flock
+        lockFd = -1;
+    }
+    opened = false;
+    readOnly = false;
+    entries.clear();
+    lru.clear();
+    touched.clear();
+    liveBytes = 0;
+    fileBytes = 0;
+    clock = 0;
+}
+
+bool LLMCache::isOpen() const {
+    return opened;
+}
+
+bool LLMCache::isReadOnly() const {
+    return readOnly;
+}
+
+bool LLMCache::load(bool& damaged) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) {
+        return true; // created on first write
+    }
+    stringstream buffer;
+    buffer << file.rdbuf();
+    string data = buffer.str();
+    if (data.empty()) {
+        return true;
+    }
+    if (data.size() >= MAGIC_SIZE && data.compare(0, MAGIC_SIZE, OLD_MAGIC, MAGIC_SIZE) == 0) {
+        cout << "[LLMCache] Replacing cache written by an older version: " << path << endl;
+        damaged = true; // rewritten empty by open()
+        fileBytes = data.size();
+        return true;
+    }
+    if (data.size() < MAGIC_SIZE || data.compare(0, MAGIC_SIZE, MAGIC) != 0) {
+        cerr << "[LLMCache] Not a cache file, leaving it alone: " << path << endl;
+        return false;
+    }
+
+    size_t pos = MAGIC_SIZE;
+    while (pos + RECORD_HEADER <= data.size()) {
+        uint8_t type = (uint8_t)data[pos];
+        uint64_t key = getLE(data, pos + 1, 8);
+        uint64_t stamp = getLE(data, pos + 9, 8);
+        size_t next = pos + RECORD_HEADER;
+
+        if (type == RECORD_PUT) {
+            if (next + 16 > data.size()) break;
+            uint64_t keyCheck = getLE(data, next, 8);
+            size_t length = (size_t)getLE(data, next + 8, 4);
+            uint32_t check = (uint32_t)getLE(data, next + 12, 4);
+            next += 16;
+            if (length > data.size() - next) break;
+            string value = data.substr(next, length);
+            if (valueCheck(value) != check) break;
+            next += length;
+
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                liveBytes -= storedSize(it->second.value);
+                it->second.value = move(value);
+                it->second.check = keyCheck;
+                it->second.stamp = stamp;
+            } else {
+                it = entries.emplace(key, Entry{move(value), keyCheck, stamp, {}}).first;
+            }
+            liveBytes += storedSize(it->second.value);
+        } else if (type == RECORD_TOUCH) {
+            auto it = entries.find(key);
+            if (it != entries.end()) it->second.stamp = stamp;
+        } else if (type == RECORD_ERASE) {
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                liveBytes -= storedSize(it->second.value);
+                entries.erase(it);
+            }
+        } else {
+            break;
+        }
+        clock = max(clock, stamp);
+        pos = next;
+    }
+    damaged = pos < data.size();
+    if (damaged) {
+        cerr << "[LLMCache] Ignoring " << (data.size() - pos) << " damaged bytes at the end of " << path << endl;
+    }
+    fileBytes = data.size();
+
+    // Rebuild the recency list from the stamps
+    vector<pair<uint64_t, uint64_t>> byStamp;
+    byStamp.reserve(entries.size());
+    for (const auto& entry : entries) {
+        byStamp.emplace_back(entry.second.stamp, entry.first);
+    }
+    sort(byStamp.begin(), byStamp.end());
+    for (const auto& item : byStamp) {
+        lru.push_front(item.second);
+        entries[item.second].position = lru.begin();
+    }
+    return true;
+}
+
+void LLMCache::append(uint8_t type, uint64_t key, uint64_t stamp, const string* value, uint64_t check) {
+    if (!log.is_open()) return;
+
+    // One write per record, so a crash leaves at most one torn record
+    string record = encodeRecord(type, key, stamp, value, check);
+    log.write(record.data(), record.size());
+    log.flush();
+    if (!log) {
+        cerr << "[LLMCache] Write failed, cache is memory-only from now on: " << path << endl;
+        log.close();
+        return;
+    }
+    fileBytes += record.size();
+}
+
+void LLMCache::writeTouches() {
+    // Oldest first, so replaying them on load gives the same order
+    vector<pair<uint64_t, uint64_t>> byStamp;
+    byStamp.reserve(touched.size());
+    for (uint64_t key : touched) {
+        auto it = entries.find(key);
+        if (it != entries.end()) byStamp.emplace_back(it->second.stamp, key);
+    }
+    touched.clear();
+    if (byStamp.empty()) return;
+    sort(byStamp.begin(), byStamp.end());
+
+    string records;
+    records.reserve(byStamp.size() * RECORD_HEADER);
+    for (const auto& item : byStamp) {
+        records += encodeRecord(RECORD_TOUCH, item.second, item.first, nullptr);
+    }
+    log.write(records.data(), records.size());
+    log.flush();
+    if (!log) {
+        cerr << "[LLMCache] Write failed, recency of this run is lost: " << path << endl;
+        log.close();
+        return;
+    }
+    fileBytes += records.size();
+}
+
+void LLMCache::evict() {
+    while (liveBytes > maxBytes && !lru.empty()) {
+        uint64_t key = lru.back();
+        auto it = entries.find(key);
+        liveBytes -= storedSize(it->second.value);
+        entries.erase(it);
+        lru.pop_back();
+        append(RECORD_ERASE, key, ++clock);
+    }
+}
+
+void LLMCache::maybeCompact() {
+    if (readOnly) return;
+    size_t live = liveBytes + MAGIC_SIZE;
+    if (fileBytes >= MIN_COMPACT_BYTES && fileBytes > 2 * live) {
+        compact();
+    }
+}
+
+bool LLMCache::compact() {
+    // Oldest first, renumbering stamps so the clock restarts small
+    string temporary = path + ".tmp";
+    ofstream out(temporary, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "[LLMCache] Could not write " << temporary << endl;
+        return false;
+    }
+
+    string header(MAGIC, MAGIC_SIZE);
+    out.write(header.data(), header.size());
+    size_t written = header.size();
+    uint64_t stamp = 0;
+    for (auto it = lru.rbegin(); it != lru.rend(); ++it) {
+        Entry& entry = entries[*it];
+        entry.stamp = ++stamp;
+
+        string record = encodeRecord(RECORD_PUT, *it, entry.stamp, &entry.value, entry.check);
+        out.write(record.data(), record.size());
+        written += record.size();
+    }
+    out.close();
+    if (!out) {
+        cerr << "[LLMCache] Could not write " << temporary << endl;
+        remove(temporary.c_str());
+        return false;
+    }
+
+    if (log.is_open()) log.close();
+    if (rename(temporary.c_str(), path.c_str()) != 0) {
+        cerr << "[LLMCache] Could not replace " << path << endl;
+        remove(temporary.c_str());
+        log.open(path, ios::binary | ios::app);
+        return false;
+    }
+    clock = stamp;
+    fileBytes = written;
+    touched.clear(); // every stamp is in the new log
+    log.open(path, ios::binary | ios::app);
+    return true;
+}
+
+bool LLMCache::get(const LLMCacheKey& key, string& value) {
+    if (!opened) return false;
+
+    auto it = entries.find(key.hash);
+    if (it == entries.end() || it->second.check != key.check) return false;
+
+    Entry& entry = it->second;
+    entry.stamp = ++clock;
+    lru.splice(lru.begin(), lru, entry.position);
+    value = entry.value;
+    touched.insert(key.hash);
+    return true;
+}
+
+void LLMCache::put(const LLMCacheKey& key, const string& value) {
+    if (!opened || storedSize(value) > maxBytes) return;
+
+    // A colliding request replaces the entry; only one can be cached
+    uint64_t stamp = ++clock;
+    auto it = entries.find(key.hash);
+    if (it != entries.end()) {
+        liveBytes -= storedSize(it->second.value);
+        it->second.value = value;
+        it->second.check = key.check;
+        it->second.stamp = stamp;
+        lru.splice(lru.begin(), lru, it->second.position);
+        touched.erase(key.hash); // the PUT carries the new stamp
+    } else {
+        lru.push_front(key.hash);
+        entries.emplace(key.hash, Entry{value, key.check, stamp, lru.begin()});
+    }
+    liveBytes += storedSize(value);
+
+    append(RECORD_PUT, key.hash, stamp, &value, key.check);
+    evict();
+    maybeCompact();
+}
+
+size_t LLMCache::size() const {
+    return entries.size();
+}
+
+size_t LLMCache::bytes() const {
+    return liveBytes;
+}
@@ -0,0 +1,114 @@
+// LLMCache.h
+#ifndef LLMCACHE_H
+#define LLMCACHE_H
+
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+// Identifies one request: hash picks the entry, check is a second hash of
+// the same material that must match too, so a 64-bit collision is a miss
+// rather than another request's reply
+struct LLMCacheKey {
+    uint64_t hash;
+    uint64_t check;
+};
+
+// Persistent cache of LLM replies, keyed by a hash of everything that
+// decides the reply (see makeKey). Entries live in memory and in one
+// append-only log file:
+//
+//   "LLMCACH2" then records of
+//   PUT    u8 1, u64 key, u64 stamp, u64 key check, u32 length, u32 value check, length bytes
+//   TOUCH  u8 2, u64 key, u64 stamp
+//   ERASE  u8 3, u64 key, u64 stamp
+//
+// all little-endian. Stamps are a logical clock that gives the LRU order
+// back on load. Hits only reorder entries in memory; their TOUCH records
+// are written together on close, so a crash loses recency, not replies.
+// Replies past maxBytes are evicted least recently used first, and the log
+// is rewritten with only live entries once it holds mostly dead records. A
+// torn record at the end (a crash mid-write) is dropped. One process at a
+// time writes the file: open takes an exclusive flock on path + ".lock"
+// (the log itself is replaced by compaction) and holds it until close.
+// Another process finds it taken and uses the cache read-only, keeping
+// its own puts in memory.
+class LLMCache {
+private:
+    struct Entry {
+        string value;
+        uint64_t check; // LLMCacheKey::check it was stored under
+        uint64_t stamp;
+        list<uint64_t>::iterator position; // in lru
+    };
+
+    string path;
+    size_t maxBytes;
+    bool opened;
+    bool readOnly;  // another process holds the lock; the file is never written
+    int lockFd;     // holds the flock while open, -1 if none
+    ofstream log;
+    unordered_map<uint64_t, Entry> entries;
+    list<uint64_t> lru;  // most recently used first
+    unordered_set<uint64_t> touched; // hit since their stamp was last written
+    size_t liveBytes;    // entry sizes as stored in the log
+    size_t fileBytes;
+    uint64_t clock;
+
+    // Read the log into memory; false only if it exists but is not a cache.
+    // damaged is set if it ended in a torn or corrupt record.
+    bool load(bool& damaged);
+
+    void append(uint8_t type, uint64_t key, uint64_t stamp, const string* value = nullptr, uint64_t check = 0);
+
+    // One TOUCH record per entry hit since the last compaction, in one write
+    void writeTouches();
+
+    // Drop least recently used entries until the cache fits in maxBytes
+    void evict();
+
+    // Rewrite the log with only live entries when dead records dominate it
+    void maybeCompact();
+
+    // Write live entries to a temporary file and rename it over the log
+    bool compact();
+
+public:
+    LLMCache();
+    ~LLMCache();
+
+    LLMCache(const LLMCache&) = delete;
+    LLMCache& operator=(const LLMCache&) = delete;
+
+    // Open or create the cache file, dropping anything beyond maxBytes
+    bool open(const string& filename, size_t maxBytes);
+
+    // Write the recency of this session's hits and close the file
+    void close();
+
+    bool isOpen() const;
+
+    // Opened while another process was writing the file
+    bool isReadOnly() const;
+
+    // Cached reply for key; a hit makes the entry most recently used
+    bool get(const LLMCacheKey& key, string& value);
+
+    // Store or replace the reply for key
+    void put(const LLMCacheKey& key, const string& value);
+
+    size_t size() const;
+    size_t bytes() const;
+
+    // Key for one request; the parts are hashed with their boundaries, so
+    // shifting text between them gives a different key
+    static LLMCacheKey makeKey(string_view model, string_view options, string_view prompt);
+};
+
+#endif
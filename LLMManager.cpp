@@ -1,9 +1,43 @@
 // LLMManager.cpp
 #include "LLMManager.h"
-#include <curl/curl.h>
+#include "LLMCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 
+// Cap on how long the circuit stays open after repeated failures
+static const std::chrono::milliseconds MAX_COOLDOWN(5 * 60 * 1000);
+
+// Health probes should not stall the menu when the server is down
+static const long PROBE_TIMEOUT_SECONDS = 2;
+static const long CONNECT_TIMEOUT_MS = 1500;
+
+// Generation requests, streamed or not
+static const long GENERATE_TIMEOUT_SECONDS = 120;
+
+// Length of each section summary in a map-reduce run
+static const size_t CHUNK_SUMMARY_TOKENS = 96;
+
+// Summaries kept across runs, in the working directory unless CACHE_ENV
+// names another file (set but empty turns the cache off)
+static const char* DEFAULT_CACHE_FILE = "llm_cache.bin";
+static const char* CACHE_ENV = "LLM_CACHE_FILE";
+static const size_t DEFAULT_CACHE_BYTES = 8 * 1024 * 1024;
+
+// Concurrent section requests follow the server's own setting when it is
+// exported to this process too; more than this is never useful locally
+static const char* PARALLEL_ENV = "OLLAMA_NUM_PARALLEL";
+static const unsigned MAX_IN_FLIGHT = 32;
+
+// Bump when the prompts change, so old replies stop matching
+static const char* PROMPT_VERSION = "summary-v1";
+
+// Larger chunks would not fit gemma:2b's context; text past
+// maxChunks chunks of this size is left out
+static const size_t MAX_CHUNK_CHARS = 12000;
+
 // Callback function for curl response
 size_t LLMManager::WriteCallback(void* contents, size_t size, size_t nmemb, std::string* response) {
     size_t totalSize = size * nmemb;
@@ -11,55 +45,365 @@ size_t LLMManager::WriteCallback(void* contents, size_t size, size_t nmemb, std:
     return totalSize;
 }
 
+// Escape s for use inside a JSON string literal
+static std::string jsonEscape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size() + 16);
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += (char)c;
+                }
+        }
+    }
+    return out;
+}
+
+static void appendUtf8(std::string& out, unsigned long code) {
+    if (code < 0x80) {
+        out += (char)code;
+    } else if (code < 0x800) {
+        out += (char)(0xC0 | (code >> 6));
+        out += (char)(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += (char)(0xE0 | (code >> 12));
+        out += (char)(0x80 | ((code >> 6) & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    } else {
+        out += (char)(0xF0 | (code >> 18));
+        out += (char)(0x80 | ((code >> 12) & 0x3F));
+        out += (char)(0x80 | ((code >> 6) & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    }
+}
+
+// Four hex digits at s[pos]; false if they are not all hex
+static bool parseHex4(const std::string& s, size_t pos, unsigned long& value) {
+    if (pos + 4 > s.size()) return false;
+    value = 0;
+    for (size_t i = pos; i < pos + 4; i++) {
+        char c = s[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        else return false;
+    }
+    return true;
+}
+
+// Decoded value of the top-level string field "key" in one JSON object.
+// Handles every JSON escape, including \u surrogate pairs. False if the
+// field is missing or is not a string.
+static bool jsonStringField(const std::string& json, const std::string& key, std::string& value) {
+    std::string quotedKey = "\"" + key + "\"";
+    size_t pos = json.find(quotedKey);
+    if (pos == std::string::npos) return false;
+    pos = json.find_first_not_of(" \t", pos + quotedKey.size());
+    if (pos == std::string::npos || json[pos] != ':') return false;
+    pos = json.find_first_not_of(" \t", pos + 1);
+    if (pos == std::string::npos || json[pos] != '"') return false;
+
+    value.clear();
+    for (size_t i = pos + 1; i < json.size(); i++) {
+        char c = json[i];
+        if (c == '"') return true;
+        if (c != '\\') {
+            value += c;
+            continue;
+        }
+        if (++i >= json.size()) return false;
+        switch (json[i]) {
+            case 'n': value += '\n'; break;
+            case 't': value += '\t'; break;
+            case 'r': value += '\r'; break;
+            case 'b': value += '\b'; break;
+            case 'f': value += '\f'; break;
+            case 'u': {
+                unsigned long code;
+                if (!parseHex4(json, i + 1, code)) return false;
+                i += 4;
+                // A high surrogate combines with the \uDC00-\uDFFF that follows
+                unsigned long low;
+                if (code >= 0xD800 && code <= 0xDBFF && i + 6 < json.size() && json[i + 1] == '\\'
+                    && json[i + 2] == 'u' && parseHex4(json, i + 3, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                } else if (code >= 0xD800 && code <= 0xDFFF) {
+                    code = 0xFFFD; // unpaired surrogate
+                }
+                appendUtf8(value, code);
+                break;
+            }
+            default: value += json[i]; break; // \" \\ \/
+        }
+    }
+    return false;
+}
+
 LLMManager::LLMManager(const std::string& url, const std::string& model) 
-    : apiUrl(url), modelName(model) {
+    : apiUrl(url), modelName(model), curl(nullptr), jsonHeaders(nullptr), multi(nullptr),
+      chunkChars(1500), maxChunks(16), maxInFlight(4), healthy(false), healthKnown(false),
+      consecutiveFailures(0), healthTtl(30000), failureThreshold(3), baseCooldown(30000),
+      cancelRequested(false) {
     curl_global_init(CURL_GLOBAL_DEFAULT);
+    curl = curl_easy_init();
+    multi = curl_multi_init();
+    jsonHeaders = curl_slist_append(jsonHeaders, "Content-Type: application/json");
     std::cout << "[LLMManager] Initialized with model: " << modelName << std::endl;
+    const char* parallel = std::getenv(PARALLEL_ENV);
+    if (parallel && *parallel) {
+        char* end = nullptr;
+        unsigned long requests = std::strtoul(parallel, &end, 10);
+        if (end != parallel && *end == '\0' && requests >= 1 && requests <= MAX_IN_FLIGHT) {
+            setChunking(chunkChars, maxChunks, (unsigned)requests);
+        } else {
+            std::cout << "[LLMManager] Ignoring " << PARALLEL_ENV << "=" << parallel
+                      << " (expected 1 to " << MAX_IN_FLIGHT << ")" << std::endl;
+        }
+    }
+    const char* cacheFile = std::getenv(CACHE_ENV);
+    setCache(cacheFile ? cacheFile : DEFAULT_CACHE_FILE, DEFAULT_CACHE_BYTES);
 }
 
 LLMManager::~LLMManager() {
+    for (CURL* handle : spareHandles) {
+        curl_easy_cleanup(handle);
+    }
+    if (multi) {
+        curl_multi_cleanup(multi);
+    }
+    if (curl) {
+        curl_easy_cleanup(curl);
+    }
+    curl_slist_free_all(jsonHeaders);
     curl_global_cleanup();
 }
 
+size_t LLMManager::StreamCallback(void* contents, size_t size, size_t nmemb, StreamState* state) {
+    size_t totalSize = size * nmemb;
+    state->pending.append((char*)contents, totalSize);
+
+    // Ollama sends one JSON object per line; a line may span several writes
+    size_t start = 0;
+    size_t newline;
+    while ((newline = state->pending.find('\n', start)) != std::string::npos) {
+        std::string line = state->pending.substr(start, newline - start);
+        start = newline + 1;
+        if (!parseStreamLine(line, *state)) {
+            state->pending.erase(0, start);
+            return 0; // curl aborts the transfer with CURLE_WRITE_ERROR
+        }
+    }
+    state->pending.erase(0, start);
+    return totalSize;
+}
+
+bool LLMManager::parseStreamLine(const std::string& line, StreamState& state) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) return true;
+
+    std::string field;
+    if (jsonStringField(line, "error", field)) {
+        state.error = field;
+        return false;
+    }
+    if (jsonStringField(line, "response", field) && !field.empty()) {
+        state.text += field;
+        state.tokens++;
+        if (state.onToken && *state.onToken && !(*state.onToken)(field)) {
+            state.stopped = true;
+        }
+    }
+    if (line.find("\"done\":true") != std::string::npos) {
+        state.done = true;
+        return true;
+    }
+
+    if (state.manager->cancelRequested || (state.maxTokens > 0 && state.tokens >= state.maxTokens)) {
+        state.stopped = true;
+    }
+    return !state.stopped;
+}
+
+// curl calls this about once a second even while no bytes arrive, so a
+// cancel also ends a request that is still waiting for the model to load
+int LLMManager::ProgressCallback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    StreamState* state = static_cast<StreamState*>(clientp);
+    if (state->manager->cancelRequested) {
+        state->stopped = true;
+        return 1; // curl aborts the transfer with CURLE_ABORTED_BY_CALLBACK
+    }
+    return 0;
+}
+
+void LLMManager::cancel() {
+    cancelRequested = true;
+}
+
+void LLMManager::prepareRequest(CURL* handle, const std::string& url, std::string& response, long timeoutSeconds) {
+    // curl_easy_reset clears options but keeps the connection and DNS caches
+    curl_easy_reset(handle);
+    curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
+    curl_easy_setopt(handle, CURLOPT_TIMEOUT, timeoutSeconds);
+    curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT_MS, CONNECT_TIMEOUT_MS);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+}
+
+void LLMManager::prepareGenerate(CURL* handle, const std::string& payload, StreamState& state) {
+    std::string unused;
+    prepareRequest(handle, apiUrl + "/api/generate", unused, GENERATE_TIMEOUT_SECONDS);
+    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, StreamCallback);
+    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &state);
+    curl_easy_setopt(handle, CURLOPT_XFERINFOFUNCTION, ProgressCallback);
+    curl_easy_setopt(handle, CURLOPT_XFERINFODATA, &state);
+    curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, jsonHeaders);
+    curl_easy_setopt(handle, CURLOPT_POSTFIELDS, payload.c_str());
+}
+
+std::string LLMManager::generatePayload(const std::string& prompt, size_t maxTokens) const {
+    // Streamed NDJSON, so the first words show up as soon as they exist;
+    // num_predict also stops the server itself at the token limit
+    std::string payload = "{\"model\":\"" + jsonEscape(modelName) + "\",\"prompt\":\"" + jsonEscape(prompt)
+                        + "\",\"stream\":true";
+    if (maxTokens > 0) {
+        payload += ",\"options\":{\"num_predict\":" + std::to_string(maxTokens) + "}";
+    }
+    payload += "}";
+    return payload;
+}
+
+bool LLMManager::setCache(const std::string& path, size_t maxBytes) {
+    if (path.empty() || maxBytes == 0) {
+        cache.close();
+        return true;
+    }
+    if (!cache.open(path, maxBytes)) {
+        std::cout << "[LLMManager] Warning: summary cache disabled (" << path << ")" << std::endl;
+        return false;
+    }
+    std::cout << "[LLMManager] Summary cache: " << cache.size() << " entries in " << path << std::endl;
+    return true;
+}
+
+void LLMManager::setChunking(size_t chars, size_t chunks, unsigned inFlight) {
+    chunkChars = std::max<size_t>(chars, 100);
+    maxChunks = std::max<size_t>(chunks, 1);
+    maxInFlight = std::max(inFlight, 1u);
+}
+
+void LLMManager::recordSuccess() {
+    healthy = true;
+    healthKnown = true;
+    healthCheckedAt = std::chrono::steady_clock::now();
+    consecutiveFailures = 0;
+}
+
+void LLMManager::recordFailure() {
+    healthy = false;
+    healthKnown = true;
+    healthCheckedAt = std::chrono::steady_clock::now();
+    consecutiveFailures++;
+
+    if (consecutiveFailures >= failureThreshold) {
+        // Back off further each time a half-open probe fails again
+        int doublings = std::min(consecutiveFailures - failureThreshold, 16);
+        std::chrono::milliseconds cooldown = std::min(MAX_COOLDOWN, baseCooldown * (1 << doublings));
+        circuitOpenUntil = healthCheckedAt + cooldown;
+        std::cout << "[LLMManager] Server unreachable " << consecutiveFailures
+                  << " times in a row; not retrying for " << cooldown.count() << " ms" << std::endl;
+    }
+}
+
+bool LLMManager::circuitOpen() const {
+    return consecutiveFailures >= failureThreshold
+        && std::chrono::steady_clock::now() < circuitOpenUntil;
+}
+
+void LLMManager::setHealthPolicy(std::chrono::milliseconds ttl, int threshold, std::chrono::milliseconds cooldown) {
+    healthTtl = ttl;
+    failureThreshold = std::max(1, threshold);
+    baseCooldown = cooldown;
+}
+
 bool LLMManager::isServerAvailable() {
-    CURL* curl = curl_easy_init();
-    if (!curl) {
+    if (!curl || circuitOpen()) {
         return false;
     }
+    // Once the breaker has opened, its cooldown decides when to probe again
+    bool halfOpen = consecutiveFailures >= failureThreshold;
+    if (healthKnown && !halfOpen && std::chrono::steady_clock::now() - healthCheckedAt < healthTtl) {
+        return healthy;
+    }
     
     std::string response;
     std::string testUrl = apiUrl + "/api/tags";
-    
-    curl_easy_setopt(curl, CURLOPT_URL, testUrl.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+    prepareRequest(curl, testUrl, response, PROBE_TIMEOUT_SECONDS);
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
     
     CURLcode res = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
-    
-    return (res == CURLE_OK);
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+    if (res == CURLE_OK && http_code == 200) {
+        recordSuccess();
+    } else {
+        recordFailure();
+    }
+    return healthy;
 }
 
-std::string LLMManager::generateSummary(const std::string& policyText, const std::string& keywordAnalysis) {
-    CURL* curl;
-    CURLcode res;
-    std::string response;
+std::vector<std::string> LLMManager::splitIntoChunks(const std::string& text) const {
+    // Grow chunks rather than drop text, up to what the model can take
+    size_t size = std::max(chunkChars, (text.size() + maxChunks - 1) / maxChunks);
+    size = std::min(size, MAX_CHUNK_CHARS);
 
-    curl = curl_easy_init();
-    if(!curl) {
-        return "Error: Failed to initialize CURL";
+    std::vector<std::string> chunks;
+    size_t start = 0;
+    while (start < text.size() && chunks.size() < maxChunks) {
+        size_t end = std::min(text.size(), start + size);
+        if (end < text.size()) {
+            // Prefer the last sentence end in the second half of the chunk,
+            // then the last space
+            size_t cut = text.find_last_of(".!?", end - 1);
+            if (cut == std::string::npos || cut < start + size / 2) {
+                cut = text.rfind(' ', end - 1);
+            }
+            if (cut != std::string::npos && cut > start + size / 2) {
+                end = cut + 1;
+            }
+        }
+        chunks.push_back(text.substr(start, end - start));
+        start = end;
+        while (start < text.size() && text[start] == ' ') start++;
     }
+    if (start < text.size()) {
+        std::cout << "[LLMManager] Policy too long; summarizing the first " << start
+                  << " of " << text.size() << " characters" << std::endl;
+    }
+    return chunks;
+}
 
-    std::string url = apiUrl + "/api/generate";
-    
-    // Drastically reduce text length for Gemma 2B
-    size_t maxLength = 500; // Much smaller for Gemma 2B
-    std::string textToAnalyze = policyText.substr(0, maxLength);
+std::string LLMManager::generateSummary(std::string_view policyText, const std::string& keywordAnalysis,
+                                        const TokenCallback& onToken, size_t maxTokens) {
+    cancelRequested = false;
     
     // Simple cleaning
     std::string cleanText;
-    for (char c : textToAnalyze) {
+    for (char c : policyText) {
         if (c == '\r' || c == '\n') {
             cleanText += ' ';
         } else if (c == '"') {
@@ -98,87 +442,239 @@ std::string LLMManager::generateSummary(const std::string& policyText, const std
             keywordHint += " Focus on user rights.";
         }
     }
-    
-    // Very simple prompt for Gemma 2B
-    std::string prompt = "Summarize this privacy policy in 3-4 sentences:" + keywordHint + " Text: " + finalText;
 
-    std::cout << "[LLMManager] Using simplified prompt for Gemma 2B" << std::endl;
-    std::cout << "[LLMManager] Prompt length: " << prompt.length() << std::endl;
+    // Everything that shapes the reply goes into the key
+    std::string options = std::string(PROMPT_VERSION) + " num_predict=" + std::to_string(maxTokens)
+                        + " chunk_chars=" + std::to_string(chunkChars) + " max_chunks=" + std::to_string(maxChunks)
+                        + " section_tokens=" + std::to_string(CHUNK_SUMMARY_TOKENS);
+    LLMCacheKey cacheKey = LLMCache::makeKey(modelName, options, keywordHint + "\n" + finalText);
+    std::string cached;
+    if (cache.get(cacheKey, cached)) {
+        std::cout << "[LLMManager] Summary served from cache" << std::endl;
+        if (onToken) onToken(cached);
+        return cached;
+    }
+
+    bool declined = false;
+    TokenCallback relay;
+    if (onToken) {
+        relay = [&](const std::string& token) {
+            if (onToken(token)) return true;
+            declined = true;
+            return false;
+        };
+    }
+    bool complete = true;
+    std::string summary = summarize(finalText, keywordHint, relay, maxTokens, complete);
 
-    // Simple JSON payload
-    std::string jsonPayload = "{\"model\":\"gemma:2b\",\"prompt\":\"" + prompt + "\",\"stream\":false}";
+    // A reply cut short by cancel() or the caller, or missing sections, is
+    // not the full answer
+    if (summary.find("Error:") != 0 && complete && !cancelRequested && !declined) {
+        cache.put(cacheKey, summary);
+    }
+    return summary;
+}
 
-    struct curl_slist* headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+std::string LLMManager::summarize(const std::string& text, const std::string& keywordHint,
+                                  const TokenCallback& onToken, size_t maxTokens, bool& complete) {
+    std::vector<std::string> chunks = splitIntoChunks(text);
+    if (chunks.size() <= 1) {
+        // Very simple prompt for Gemma 2B
+        std::string prompt = "Summarize this privacy policy in 3-4 sentences:" + keywordHint
+                           + " Text: " + (chunks.empty() ? "" : chunks[0]);
 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, jsonPayload.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 120L); // Reduced timeout
-    
-    // Disable verbose output for cleaner logs
-    // curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
+        std::cout << "[LLMManager] Using simplified prompt for Gemma 2B" << std::endl;
+        std::cout << "[LLMManager] Prompt length: " << prompt.length() << std::endl;
+        return generate(prompt, onToken, maxTokens);
+    }
 
-    std::cout << "[LLMManager] Sending request to LLM (timeout: 120s)..." << std::endl;
-    res = curl_easy_perform(curl);
+    // Map: summarize every section at once, so the wait is the slowest
+    // section rather than the sum of them
+    std::vector<std::string> prompts;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        prompts.push_back("Summarize part " + std::to_string(i + 1) + " of " + std::to_string(chunks.size())
+                          + " of a privacy policy in 1-2 sentences:" + keywordHint + " Text: " + chunks[i]);
+    }
+    std::cout << "[LLMManager] Summarizing " << chunks.size() << " sections, up to "
+              << maxInFlight << " at a time" << std::endl;
+    std::vector<std::string> partial = generateAll(prompts, CHUNK_SUMMARY_TOKENS);
 
-    long http_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-    
-    curl_easy_cleanup(curl);
-    curl_slist_free_all(headers);
+    // Reduce: one streamed request combines the section summaries
+    std::string combined;
+    size_t usable = 0;
+    for (size_t i = 0; i < partial.size(); i++) {
+        if (partial[i].find("Error:") == 0) {
+            std::cout << "[LLMManager] Section " << (i + 1) << " failed: " << partial[i] << std::endl;
+            continue;
+        }
+        combined += " Part " + std::to_string(i + 1) + ": " + partial[i];
+        usable++;
+    }
+    if (cancelRequested) {
+        return "Error: Generation cancelled";
+    }
+    if (usable == 0) {
+        return partial.empty() ? "Error: Empty policy text" : partial[0];
+    }
+    complete = usable == partial.size();
+
+    std::string prompt = "Combine these summaries of the parts of one privacy policy into a 3-4 sentence summary of the whole policy:"
+                       + keywordHint + combined;
+    std::cout << "[LLMManager] Combining " << usable << " section summaries" << std::endl;
+    return generate(prompt, onToken, maxTokens);
+}
+
+std::string LLMManager::finishGenerate(StreamState& state, CURLcode res, long http_code) {
+    // An error body need not end in a newline
+    if (res == CURLE_OK && !state.pending.empty()) {
+        parseStreamLine(state.pending, state);
+    }
+
+    // Stopping early aborts the transfer on purpose; that is not a failure,
+    // but only output proves the server is up (a cancel may come first)
+    if (state.stopped) {
+        if (state.tokens > 0) recordSuccess();
+        std::cout << "[LLMManager] Generation stopped after " << state.tokens << " tokens" << std::endl;
+        return state.text.empty() ? "Error: Generation cancelled" : state.text;
+    }
 
-    if(res != CURLE_OK) {
+    // A completed request answers the health question as well as a probe
+    if(res != CURLE_OK && state.error.empty()) {
+        recordFailure();
         std::string error = "Error: CURL failed - ";
         error += curl_easy_strerror(res);
         std::cout << "[LLMManager] " << error << std::endl;
         return error;
     }
 
+    if (http_code >= 500) {
+        recordFailure();
+    } else {
+        recordSuccess();
+    }
+    if (!state.error.empty()) {
+        std::string error = "Error: " + state.error;
+        std::cout << "[LLMManager] " << error << std::endl;
+        return error;
+    }
     if (http_code != 200) {
         std::string error = "Error: HTTP " + std::to_string(http_code);
         std::cout << "[LLMManager] " << error << std::endl;
-        std::cout << "[LLMManager] Response: " << response << std::endl;
         return error;
     }
 
-    // Parse response
-    if (response.empty()) {
-        return "Error: Empty response from LLM server";
-    }
-
-    // Simple JSON parsing
-    size_t responsePos = response.find("\"response\":\"");
-    if (responsePos != std::string::npos) {
-        responsePos += 12;
-        size_t endPos = response.find("\"", responsePos);
-        if (endPos != std::string::npos) {
-            std::string extracted = response.substr(responsePos, endPos - responsePos);
-            
-            // Basic unescaping
-            std::string result;
-            for (size_t i = 0; i < extracted.length(); i++) {
-                if (extracted[i] == '\\' && i + 1 < extracted.length()) {
-                    if (extracted[i+1] == 'n') {
-                        result += '\n';
-                        i++;
-                    } else if (extracted[i+1] == '\\' || extracted[i+1] == '"') {
-                        result += extracted[i+1];
-                        i++;
-                    } else {
-                        result += extracted[i];
-                    }
-                } else {
-                    result += extracted[i];
-                }
+    if (state.text.empty()) {
+        return state.done ? "Error: Empty response from LLM server" : "Error: Could not parse LLM response";
+    }
+    return state.text;
+}
+
+std::string LLMManager::generate(const std::string& prompt, const TokenCallback& onToken, size_t maxTokens) {
+    if(!curl) {
+        return "Error: Failed to initialize CURL";
+    }
+    if (circuitOpen()) {
+        return "Error: LLM server unavailable (recent requests failed)";
+    }
+
+    std::string payload = generatePayload(prompt, maxTokens);
+    StreamState state = {this, &onToken, maxTokens, "", "", 0, false, false, ""};
+    prepareGenerate(curl, payload, state);
+
+    std::cout << "[LLMManager] Sending request to LLM (timeout: " << GENERATE_TIMEOUT_SECONDS << "s)..." << std::endl;
+    CURLcode res = curl_easy_perform(curl);
+
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+    std::string result = finishGenerate(state, res, http_code);
+    if (result.find("Error:") != 0) {
+        std::cout << "[LLMManager] Successfully generated summary" << std::endl;
+    }
+    return result;
+}
+
+std::vector<std::string> LLMManager::generateAll(const std::vector<std::string>& prompts, size_t maxTokens) {
+    std::vector<std::string> results(prompts.size());
+    if (!multi) {
+        results.assign(prompts.size(), "Error: Failed to initialize CURL");
+        return results;
+    }
+    if (circuitOpen()) {
+        results.assign(prompts.size(), "Error: LLM server unavailable (recent requests failed)");
+        return results;
+    }
+
+    struct Request {
+        size_t index;
+        std::string payload;
+        StreamState state;
+    };
+    std::vector<Request> requests(prompts.size());
+    size_t next = 0;
+    size_t inFlight = 0;
+
+    auto start = [&](CURL* handle) {
+        Request& request = requests[next];
+        request.index = next++;
+        request.payload = generatePayload(prompts[request.index], maxTokens);
+        request.state = {this, nullptr, maxTokens, "", "", 0, false, false, ""};
+        prepareGenerate(handle, request.payload, request.state);
+        curl_easy_setopt(handle, CURLOPT_PRIVATE, (char*)&request);
+        curl_multi_add_handle(multi, handle);
+        inFlight++;
+    };
+
+    while (next < prompts.size() && inFlight < maxInFlight) {
+        CURL* handle = nullptr;
+        if (!spareHandles.empty()) {
+            handle = spareHandles.back();
+            spareHandles.pop_back();
+        } else {
+            handle = curl_easy_init();
+        }
+        if (!handle) break;
+        start(handle);
+    }
+
+    while (inFlight > 0) {
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        CURLMsg* message;
+        int queued;
+        while ((message = curl_multi_info_read(multi, &queued))) {
+            if (message->msg != CURLMSG_DONE) continue;
+
+            CURL* handle = message->easy_handle;
+            CURLcode res = message->data.result;
+            char* privateData = nullptr;
+            long http_code = 0;
+            curl_easy_getinfo(handle, CURLINFO_PRIVATE, &privateData);
+            curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &http_code);
+            curl_multi_remove_handle(multi, handle);
+            inFlight--;
+
+            Request& request = *(Request*)privateData;
+            results[request.index] = finishGenerate(request.state, res, http_code);
+
+            // The freed handle, and its connection, take the next section
+            if (next < prompts.size() && !cancelRequested && !circuitOpen()) {
+                start(handle);
+            } else {
+                spareHandles.push_back(handle);
             }
-            
-            std::cout << "[LLMManager] Successfully generated summary" << std::endl;
-            return result;
+        }
+
+        if (inFlight > 0) {
+            curl_multi_poll(multi, nullptr, 0, 100, nullptr);
         }
     }
 
-    return "Error: Could not parse LLM response";
+    // Sections never started because of cancel() or an open circuit
+    for (size_t i = next; i < prompts.size(); i++) {
+        results[i] = cancelRequested ? "Error: Generation cancelled"
+                                     : "Error: LLM server unavailable (recent requests failed)";
+    }
+    return results;
 }
\ No newline at end of file
@@ -2,23 +2,153 @@
 #ifndef LLMMANAGER_H
 #define LLMMANAGER_H
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <vector>
+#include <curl/curl.h>
+#include "LLMCache.h"
 
+// Receives generated text as it streams in; return false to stop generating
+using TokenCallback = std::function<bool(const std::string& token)>;
+
+// Client for the local Ollama server. One curl handle lives as long as the
+// manager, so requests reuse its keep-alive connection; use it from one
+// thread at a time.
+//
+// Server health is cached: a result from a probe or a real request is
+// trusted for healthTtl. After failureThreshold consecutive failures the
+// circuit opens and calls fail immediately for the cooldown (doubling on
+// each further failure), after which one probe decides whether it closes.
+//
+// Finished summaries are cached on disk (see LLMCache), so asking again
+// for the same text, model and options skips the server entirely.
 class LLMManager {
 private:
     std::string apiUrl;
     std::string modelName;
+    CURL* curl; // persistent handle; nullptr if curl could not initialize
+    struct curl_slist* jsonHeaders;
+
+    // Parallel chunk requests for long policies (map-reduce summaries)
+    CURLM* multi;
+    std::vector<CURL*> spareHandles; // idle easy handles for multi, kept for reuse
+    size_t chunkChars;               // policy characters per map request
+    size_t maxChunks;
+    unsigned maxInFlight;            // concurrent map requests
+
+    bool healthy;
+    bool healthKnown;
+    std::chrono::steady_clock::time_point healthCheckedAt;
+    int consecutiveFailures;
+    std::chrono::steady_clock::time_point circuitOpenUntil;
+
+    std::chrono::milliseconds healthTtl;
+    int failureThreshold;
+    std::chrono::milliseconds baseCooldown;
+
+    std::atomic<bool> cancelRequested;
+
+    LLMCache cache; // closed when caching is off
+
+    // Incremental state of one streamed /api/generate reply
+    struct StreamState {
+        LLMManager* manager;
+        const TokenCallback* onToken;
+        size_t maxTokens;   // 0 = no limit
+        std::string pending; // bytes after the last complete NDJSON line
+        std::string text;    // tokens so far
+        size_t tokens;
+        bool stopped;        // cut off by the callback, cancel() or maxTokens
+        bool done;           // the server sent "done":true
+        std::string error;   // "error" field of a chunk, if any
+    };
     
     static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* response);
 
+    // Feeds streamed bytes to parseStreamLine; returns 0 to make curl abort
+    static size_t StreamCallback(void* contents, size_t size, size_t nmemb, StreamState* state);
+
+    // Aborts the transfer once cancel() was called, also before any output
+    static int ProgressCallback(void* clientp, curl_off_t dltotal, curl_off_t dlnow,
+                                curl_off_t ultotal, curl_off_t ulnow);
+
+    // One NDJSON chunk; false once generation should stop
+    static bool parseStreamLine(const std::string& line, StreamState& state);
+
+    // Send prompt to /api/generate with streaming on. Tokens go to onToken
+    // (may be empty) as they arrive; the text generated so far is returned
+    // when stopped early, an "Error: ..." string on failure.
+    std::string generate(const std::string& prompt, const TokenCallback& onToken, size_t maxTokens);
+
+    // Run every prompt, at most maxInFlight at a time, on the multi handle.
+    // Results are in prompt order, each a text or an "Error: ..." string.
+    std::vector<std::string> generateAll(const std::vector<std::string>& prompts, size_t maxTokens);
+
+    // Reset handle for a new request to url; keeps its open connections
+    void prepareRequest(CURL* handle, const std::string& url, std::string& response, long timeoutSeconds);
+
+    // Set handle up to stream a /api/generate reply for payload into state
+    void prepareGenerate(CURL* handle, const std::string& payload, StreamState& state);
+
+    // /api/generate request body for prompt
+    std::string generatePayload(const std::string& prompt, size_t maxTokens) const;
+
+    // Text of a finished streamed request, or an "Error: ..." string
+    std::string finishGenerate(StreamState& state, CURLcode res, long http_code);
+
+    // Summary of cleaned text: one request, or map-reduce over its chunks.
+    // complete is cleared when some sections failed and were left out.
+    std::string summarize(const std::string& text, const std::string& keywordHint,
+                          const TokenCallback& onToken, size_t maxTokens, bool& complete);
+
+    // Split cleaned text into at most maxChunks pieces of about chunkChars,
+    // cut at sentence ends where possible
+    std::vector<std::string> splitIntoChunks(const std::string& text) const;
+
+    void recordSuccess();
+    void recordFailure();
+
+    // True while the breaker rejects calls without touching the network
+    bool circuitOpen() const;
+
 public:
     LLMManager(const std::string& url = "http://localhost:11434", const std::string& model = "gemma:2b");
+
+    LLMManager(const LLMManager&) = delete;
+    LLMManager& operator=(const LLMManager&) = delete;
     
-    // Generate summary with optional keyword analysis
-    std::string generateSummary(const std::string& policyText, const std::string& keywordAnalysis = "");
+    // Generate summary with optional keyword analysis. onToken sees the
+    // text as the model produces it; maxTokens > 0 stops generation there.
+    // Policies longer than one chunk are summarized map-reduce style: the
+    // chunks in parallel, then one request combines their summaries.
+    std::string generateSummary(std::string_view policyText, const std::string& keywordAnalysis = "",
+                                const TokenCallback& onToken = nullptr, size_t maxTokens = 0);
+
+    // Stop the generation in progress (safe from another thread); it
+    // returns the text produced so far
+    void cancel();
     
+    // Cached health; probes /api/tags only when the cached state has expired
     bool isServerAvailable();
+
+    // ttl: how long a health result is trusted; threshold: consecutive
+    // failures that open the circuit; cooldown: first open period
+    void setHealthPolicy(std::chrono::milliseconds ttl, int threshold, std::chrono::milliseconds cooldown);
+
+    // Characters per chunk, most chunks per policy and concurrent chunk
+    // requests. Ollama only runs requests side by side up to its own
+    // OLLAMA_NUM_PARALLEL; the constructor takes inFlight from that
+    // variable when it is set for this process (default 4).
+    void setChunking(size_t chars, size_t chunks, unsigned inFlight);
+
+    // Cache summaries in path, evicting least recently used ones beyond
+    // maxBytes. An empty path or zero size turns caching off. The
+    // constructor uses $LLM_CACHE_FILE, or llm_cache.bin when it is unset.
+    bool setCache(const std::string& path, size_t maxBytes);
     
     virtual ~LLMManager();
 };
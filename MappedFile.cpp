@@ -0,0 +1,69 @@
+// MappedFile.cpp
+#include "MappedFile.h"
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() : data(nullptr), size(0), opened(false) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const string& filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "[MappedFile] Could not open file: " << filename << endl;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        cerr << "[MappedFile] Could not stat file: " << filename << endl;
+        ::close(fd);
+        return false;
+    }
+
+    // mmap rejects zero-length mappings; an empty file is just an empty view
+    size = (size_t)info.st_size;
+    if (size > 0) {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            cerr << "[MappedFile] Could not map file: " << filename << endl;
+            ::close(fd);
+            size = 0;
+            return false;
+        }
+        data = mapping;
+        // Analysis reads front to back
+        madvise(data, size, MADV_SEQUENTIAL);
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+    opened = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if (data) {
+        munmap(data, size);
+        data = nullptr;
+    }
+    size = 0;
+    opened = false;
+}
+
+bool MappedFile::isOpen() const {
+    return opened;
+}
+
+string_view MappedFile::view() const {
+    if (!data) return string_view();
+    return string_view(static_cast<const char*>(data), size);
+}
@@ -0,0 +1,35 @@
+// MappedFile.h
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// Read-only memory mapping of a whole file, exposed as a string_view so the
+// text can be analyzed and stored without copying it into heap strings.
+class MappedFile {
+private:
+    void* data;
+    size_t size;
+    bool opened;
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map filename, replacing any previous mapping
+    bool open(const string& filename);
+    void close();
+
+    bool isOpen() const;
+
+    // Valid until close() or the next open()
+    string_view view() const;
+};
+
+#endif
@@ -0,0 +1,212 @@
+// PersistenceQueue.cpp
+#include "PersistenceQueue.h"
+#include <iostream>
+
+// Written tickets whose policy id is remembered for policyId()
+static const size_t MAX_TICKET_IDS = 4096;
+
+PersistenceQueue::PersistenceQueue(const string& storeSpec, size_t batchRows, size_t maxJobs,
+                                   size_t maxBytes, unsigned retryAttempts)
+    : db(openStore(storeSpec)),
+      capacity(maxJobs == 0 ? 1 : maxJobs), maxQueuedBytes(maxBytes), retries(retryAttempts),
+      queuedBytes(0), nextTicket(0), busy(false), stopping(false), failed(0) {
+    if (!db) {
+        // Nothing to write to; every enqueue is rejected
+        stopping = true;
+        return;
+    }
+    writer.reset(new BulkWriter(*db, batchRows, chrono::milliseconds(1000), maxBytes));
+    writer->setRetries(retries, chrono::milliseconds(100));
+    worker = thread(&PersistenceQueue::run, this);
+}
+
+PersistenceQueue::~PersistenceQueue() {
+    shutdown();
+}
+
+bool PersistenceQueue::waitForRoom(unique_lock<mutex>& guard, size_t bytes) {
+    // An oversized job still goes through once the queue is empty
+    notFull.wait(guard, [&]() {
+        return stopping || jobs.empty()
+            || (jobs.size() < capacity && queuedBytes + bytes <= maxQueuedBytes);
+    });
+    if (stopping) {
+        cerr << "[PersistenceQueue] Rejected write after shutdown.\n";
+        return false;
+    }
+    return true;
+}
+
+int64_t PersistenceQueue::enqueuePolicy(PolicyWrite row) {
+    unique_lock<mutex> guard(lock);
+    if (!waitForRoom(guard, row.text().size())) return -1;
+
+    int64_t ticket = nextTicket++;
+    queuedBytes += row.text().size();
+    jobs.push_back({true, move(row), -1, ticket});
+    notEmpty.notify_one();
+    return ticket;
+}
+
+bool PersistenceQueue::enqueueAnalysis(int policy_id, const string& keyword_analysis, const string& ai_summary,
+                                       AnalysisCounts counts) {
+    PolicyWrite row;
+    row.keyword_analysis = keyword_analysis;
+    row.ai_summary = ai_summary;
+    row.counts = move(counts);
+
+    unique_lock<mutex> guard(lock);
+    if (!waitForRoom(guard, 0)) return false;
+    jobs.push_back({false, move(row), policy_id, -1});
+    notEmpty.notify_one();
+    return true;
+}
+
+bool PersistenceQueue::enqueueAnalysisForTicket(int64_t ticket, const string& keyword_analysis, const string& ai_summary,
+                                                AnalysisCounts counts) {
+    if (ticket < 0) return false;
+
+    PolicyWrite row;
+    row.keyword_analysis = keyword_analysis;
+    row.ai_summary = ai_summary;
+    row.counts = move(counts);
+
+    unique_lock<mutex> guard(lock);
+    if (!waitForRoom(guard, 0)) return false;
+    jobs.push_back({false, move(row), -1, ticket});
+    notEmpty.notify_one();
+    return true;
+}
+
+void PersistenceQueue::run() {
+    db->threadInit();
+
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        notEmpty.wait(guard, [&]() { return stopping || !jobs.empty(); });
+        if (jobs.empty()) break; // stopping, and nothing left to write
+
+        // Take whatever has piled up; the writer splits it into batches
+        vector<Job> batch;
+        while (!jobs.empty()) {
+            queuedBytes -= jobs.front().isPolicy ? jobs.front().row.text().size() : 0;
+            batch.push_back(move(jobs.front()));
+            jobs.pop_front();
+        }
+        busy = true;
+        notFull.notify_all();
+
+        guard.unlock();
+        writeJobs(batch);
+        guard.lock();
+
+        busy = false;
+        if (jobs.empty()) drained.notify_all();
+    }
+
+    guard.unlock();
+    db->threadEnd();
+}
+
+void PersistenceQueue::writeJobs(vector<Job>& batch) {
+    size_t lost = 0;
+    size_t failedBefore = writer->failedRows();
+
+    for (auto& job : batch) {
+        if (job.isPolicy) {
+            size_t row = writer->nextRow();
+            ticketRows[job.policyTicket] = row;
+            rowTickets[row] = job.policyTicket;
+            writer->add(move(job.row));
+            collectWritten();
+            continue;
+        }
+
+        // An analysis of a policy still waiting in the writer joins its
+        // batch; any other names the stored policy
+        int policy_id = job.policyId;
+        if (policy_id < 0) {
+            auto row = ticketRows.find(job.policyTicket);
+            if (row != ticketRows.end() && writer->isPending(row->second)) {
+                writer->addAnalysisOf(row->second, move(job.row));
+                collectWritten();
+                continue;
+            }
+            policy_id = policyId(job.policyTicket);
+        }
+        if (policy_id < 0) {
+            cerr << "[PersistenceQueue] Dropping analysis: its policy was not stored.\n";
+            lost++;
+            continue;
+        }
+
+        job.row.policy_id = policy_id;
+        writer->add(move(job.row));
+        collectWritten();
+    }
+    writer->flush();
+    collectWritten();
+    lost += writer->failedRows() - failedBefore;
+
+    lock_guard<mutex> guard(lock);
+    failed += lost;
+}
+
+void PersistenceQueue::collectWritten() {
+    vector<pair<size_t, int>> written = writer->takeWritten();
+    if (written.empty()) return;
+
+    lock_guard<mutex> guard(lock);
+    for (const auto& row : written) {
+        auto ticket = rowTickets.find(row.first);
+        if (ticket == rowTickets.end()) continue; // an analysis row
+        ticketIds[ticket->second] = row.second;
+        ticketOrder.push_back(ticket->second);
+        ticketRows.erase(ticket->second);
+        rowTickets.erase(ticket);
+    }
+
+    // Callers only ever ask about recent tickets
+    while (ticketOrder.size() > MAX_TICKET_IDS) {
+        ticketIds.erase(ticketOrder.front());
+        ticketOrder.pop_front();
+    }
+}
+
+bool PersistenceQueue::flush() {
+    unique_lock<mutex> guard(lock);
+    drained.wait(guard, [&]() { return jobs.empty() && !busy; });
+    return failed == 0;
+}
+
+void PersistenceQueue::shutdown() {
+    {
+        lock_guard<mutex> guard(lock);
+        if (stopping) return;
+        stopping = true;
+    }
+    notEmpty.notify_all();
+    notFull.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    if (failed > 0) {
+        cerr << "[PersistenceQueue] " << failed << " write(s) could not be stored.\n";
+    }
+}
+
+int PersistenceQueue::policyId(int64_t ticket) {
+    lock_guard<mutex> guard(lock);
+    auto known = ticketIds.find(ticket);
+    return known == ticketIds.end() ? -1 : known->second;
+}
+
+size_t PersistenceQueue::failedJobs() {
+    lock_guard<mutex> guard(lock);
+    return failed;
+}
+
+size_t PersistenceQueue::queuedJobs() {
+    lock_guard<mutex> guard(lock);
+    return jobs.size() + (busy ? 1 : 0);
+}
@@ -0,0 +1,101 @@
+// PersistenceQueue.h
+#ifndef PERSISTENCEQUEUE_H
+#define PERSISTENCEQUEUE_H
+
+#include "PolicyStore.h"
+#include "BulkWriter.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Write-behind storage for policies and analyses. Callers enqueue and carry
+// on; a background thread drains the queue into stored_policies and
+// policy_analysis through one BulkWriter, so policies and analyses alike
+// are written in batched transactions and failed batches are retried. When
+// the queue is full, enqueueing blocks until the writer catches up.
+// flush() waits until everything enqueued so far is written, and
+// shutdown() (also run by the destructor) flushes and stops the writer.
+class PersistenceQueue {
+private:
+    struct Job {
+        bool isPolicy;
+        PolicyWrite row;      // policy (and analysis) to store, or just the analysis
+        int policyId;         // analysis jobs: existing policy id, or -1 to use policyTicket
+        int64_t policyTicket; // analysis jobs: policy enqueued earlier
+    };
+
+    unique_ptr<PolicyStore> db;      // used by the writer thread only
+    unique_ptr<BulkWriter> writer;   // likewise
+    size_t capacity;          // queued jobs before enqueue blocks
+    size_t maxQueuedBytes;    // queued content before enqueue blocks
+    unsigned retries;
+
+    mutex lock;
+    condition_variable notEmpty, notFull, drained;
+    deque<Job> jobs;
+    size_t queuedBytes;
+    int64_t nextTicket;
+    unordered_map<int64_t, int> ticketIds; // policy id per written ticket, -1 if failed
+    deque<int64_t> ticketOrder;            // written tickets, oldest first, to cap ticketIds
+    bool busy;                // writer is storing jobs it already dequeued
+    bool stopping;
+    size_t failed;            // jobs given up on after all retries
+    thread worker;
+
+    // Writer thread only: policies handed to the writer but not yet written
+    unordered_map<int64_t, size_t> ticketRows; // ticket -> writer row
+    unordered_map<size_t, int64_t> rowTickets; // writer row -> ticket
+
+    void run();
+    void writeJobs(vector<Job>& batch);
+
+    // Record the ids of policy rows the writer has written since last time
+    void collectWritten();
+
+    // Block until a job of this size fits; false once shutting down
+    bool waitForRoom(unique_lock<mutex>& guard, size_t bytes);
+
+public:
+    // Writes go to a store of its own, opened from storeSpec (see openStore)
+    explicit PersistenceQueue(const string& storeSpec = "", size_t batchRows = 200, size_t maxJobs = 1000,
+                              size_t maxBytes = 64 * 1024 * 1024, unsigned retryAttempts = 3);
+    ~PersistenceQueue();
+
+    PersistenceQueue(const PersistenceQueue&) = delete;
+    PersistenceQueue& operator=(const PersistenceQueue&) = delete;
+
+    // Queue a policy, together with its analysis if keyword_analysis is set.
+    // Returns a ticket for policyId() and enqueueAnalysis(), or -1 after shutdown.
+    int64_t enqueuePolicy(PolicyWrite row);
+
+    // Queue an analysis for a stored policy (policy_id >= 0) or for the
+    // policy enqueued under ticket
+    bool enqueueAnalysis(int policy_id, const string& keyword_analysis, const string& ai_summary = "",
+                         AnalysisCounts counts = AnalysisCounts());
+    bool enqueueAnalysisForTicket(int64_t ticket, const string& keyword_analysis, const string& ai_summary = "",
+                                  AnalysisCounts counts = AnalysisCounts());
+
+    // Wait until every job enqueued so far is written or given up on.
+    // True if nothing has failed since the queue was created.
+    bool flush();
+
+    // Flush and stop the writer; later enqueues are rejected
+    void shutdown();
+
+    // Stored id for a ticket: -1 if it failed, is not written yet (flush
+    // first) or is older than the last few thousand tickets written
+    int policyId(int64_t ticket);
+
+    size_t failedJobs();
+    size_t queuedJobs();
+};
+
+#endif
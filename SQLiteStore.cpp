@@ -0,0 +1,733 @@
+// SQLiteStore.cpp
+#include "SQLiteStore.h"
+#include "ContentCodec.h"
+#include "ContentHash.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+// Every connection to this name in the process sees the same database
+static const char *SHARED_MEMORY_URI = "file:/privacy_analyzer?vfs=memdb";
+
+// Resets a cached statement when the caller is done with it, so it never
+// holds a read transaction open between calls
+class StatementReset {
+private:
+    sqlite3_stmt *stmt;
+
+public:
+    explicit StatementReset(sqlite3_stmt *statement) : stmt(statement) {}
+    ~StatementReset() {
+        if (stmt) sqlite3_reset(stmt);
+    }
+};
+
+static string columnText(sqlite3_stmt *stmt, int column) {
+    const unsigned char *text = sqlite3_column_text(stmt, column);
+    if (!text) return "";
+    return string((const char *)text, sqlite3_column_bytes(stmt, column));
+}
+
+// Policy text from columns content, content_blob, content_codec, char_count
+static bool readContent(sqlite3_stmt *stmt, int first, string &text) {
+    ContentCodec codec = (ContentCodec)sqlite3_column_int(stmt, first + 2);
+    if (codec == CODEC_NONE) {
+        text = columnText(stmt, first);
+        return true;
+    }
+
+    const char *blob = (const char *)sqlite3_column_blob(stmt, first + 1);
+    string_view compressed(blob ? blob : "", sqlite3_column_bytes(stmt, first + 1));
+    return decodeContent(codec, compressed, (size_t)sqlite3_column_int64(stmt, first + 3), text);
+}
+
+SQLiteStore::SQLiteStore(const string &file) : path(file), db(nullptr), compressionEnabled(true) {
+    cout << "[SQLiteStore] Using " << (path == ":memory:" ? "in-memory database" : path) << "." << endl;
+}
+
+SQLiteStore::~SQLiteStore() {
+    close();
+}
+
+bool SQLiteStore::connect() {
+    if (db) return true;
+
+    string uri = path == ":memory:" ? SHARED_MEMORY_URI : path;
+    int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI;
+    if (sqlite3_open_v2(uri.c_str(), &db, flags, nullptr) != SQLITE_OK) {
+        lastError = db ? sqlite3_errmsg(db) : "out of memory";
+        cerr << "[SQLiteStore] Could not open " << path << ": " << lastError << endl;
+        sqlite3_close(db);
+        db = nullptr;
+        return false;
+    }
+
+    // Other stores in this process (batch workers, the write-behind queue)
+    // hold their own connections; wait for their locks instead of failing
+    sqlite3_busy_timeout(db, 10000);
+    exec("PRAGMA foreign_keys = ON");
+    if (path != ":memory:") {
+        exec("PRAGMA journal_mode = WAL");
+        exec("PRAGMA synchronous = NORMAL");
+    }
+    return true;
+}
+
+void SQLiteStore::close() {
+    for (auto &entry : statements) {
+        sqlite3_finalize(entry.second);
+    }
+    statements.clear();
+    if (db) {
+        sqlite3_close(db);
+        db = nullptr;
+    }
+}
+
+bool SQLiteStore::fail(const string &context) {
+    lastError = db ? sqlite3_errmsg(db) : "database not open";
+    cerr << "SQLite Error " << context << ": " << lastError << endl;
+    return false;
+}
+
+sqlite3_stmt *SQLiteStore::prepare(const string &sql) {
+    auto found = statements.find(sql);
+    if (found != statements.end()) {
+        sqlite3_reset(found->second);
+        sqlite3_clear_bindings(found->second);
+        return found->second;
+    }
+
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        fail("preparing statement");
+        return nullptr;
+    }
+    statements[sql] = stmt;
+    return stmt;
+}
+
+bool SQLiteStore::exec(const string &sql) {
+    char *message = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &message) != SQLITE_OK) {
+        lastError = message ? message : sqlite3_errmsg(db);
+        sqlite3_free(message);
+        cerr << "SQLite Error: " << lastError << endl;
+        return false;
+    }
+    return true;
+}
+
+// Schema changes in the order they were introduced. Append new versions;
+// never edit one that has shipped.
+static const vector<pair<int, const char *>> &sqliteMigrations() {
+    static const vector<pair<int, const char *>> migrations = {
+        {1, R"(
+            CREATE TABLE IF NOT EXISTS privacy_keywords (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                keyword TEXT,
+                category TEXT
+            );
+            INSERT INTO privacy_keywords (keyword, category)
+            SELECT column1, column2 FROM (VALUES
+                ('collect', 'Data Collection'),
+                ('share', 'Data Sharing'),
+                ('consent', 'User Rights'),
+                ('delete', 'User Rights'),
+                ('third party', 'Data Sharing'))
+            WHERE NOT EXISTS (SELECT 1 FROM privacy_keywords);
+
+            CREATE TABLE IF NOT EXISTS stored_policies (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                content TEXT,
+                content_blob BLOB,
+                content_codec INTEGER NOT NULL DEFAULT 0,
+                preview TEXT,
+                source TEXT NOT NULL,
+                filename TEXT,
+                char_count INTEGER,
+                content_hash INTEGER,
+                analysis_date TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+                created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+            );
+            CREATE INDEX IF NOT EXISTS idx_content_hash ON stored_policies (content_hash);
+            CREATE INDEX IF NOT EXISTS idx_analysis_date ON stored_policies (analysis_date);
+
+            CREATE TABLE IF NOT EXISTS policy_analysis (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                policy_id INTEGER NOT NULL REFERENCES stored_policies (id) ON DELETE CASCADE,
+                keyword_analysis TEXT NOT NULL,
+                ai_summary TEXT,
+                analysis_date TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+            );
+            CREATE INDEX IF NOT EXISTS idx_policy_date ON policy_analysis (policy_id, analysis_date);
+        )"},
+        {2, R"(
+            ALTER TABLE policy_analysis ADD COLUMN counted INTEGER NOT NULL DEFAULT 0;
+            CREATE INDEX IF NOT EXISTS idx_policy_counted ON policy_analysis (policy_id, counted, id);
+
+            CREATE TABLE IF NOT EXISTS analysis_category_counts (
+                analysis_id INTEGER NOT NULL REFERENCES policy_analysis (id) ON DELETE CASCADE,
+                category TEXT NOT NULL,
+                occurrences INTEGER NOT NULL,
+                PRIMARY KEY (analysis_id, category)
+            ) WITHOUT ROWID;
+            CREATE INDEX IF NOT EXISTS idx_category ON analysis_category_counts (category);
+
+            CREATE TABLE IF NOT EXISTS analysis_keyword_counts (
+                analysis_id INTEGER NOT NULL REFERENCES policy_analysis (id) ON DELETE CASCADE,
+                category TEXT NOT NULL,
+                keyword TEXT NOT NULL,
+                occurrences INTEGER NOT NULL,
+                PRIMARY KEY (analysis_id, category, keyword)
+            ) WITHOUT ROWID;
+            CREATE INDEX IF NOT EXISTS idx_keyword ON analysis_keyword_counts (keyword);
+        )"}
+    };
+    return migrations;
+}
+
+bool SQLiteStore::migrateSchema() {
+    if (!connect()) return false;
+
+    // IMMEDIATE takes the write lock up front, serializing concurrent startups
+    if (!exec("CREATE TABLE IF NOT EXISTS schema_version ("
+              "version INTEGER NOT NULL PRIMARY KEY, "
+              "applied_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP)")
+        || !exec("BEGIN IMMEDIATE")) {
+        return false;
+    }
+
+    int current = 0;
+    {
+        sqlite3_stmt *stmt = prepare("SELECT COALESCE(MAX(version), 0) FROM schema_version");
+        if (!stmt) {
+            exec("ROLLBACK");
+            return false;
+        }
+        StatementReset reset(stmt);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            current = sqlite3_column_int(stmt, 0);
+        }
+    }
+
+    for (const auto &migration : sqliteMigrations()) {
+        if (migration.first <= current) continue;
+
+        cout << "[SQLiteStore] Applying schema version " << migration.first << "." << endl;
+        if (!exec(migration.second)
+            || !exec("INSERT INTO schema_version (version) VALUES (" + to_string(migration.first) + ")")) {
+            exec("ROLLBACK");
+            return false;
+        }
+    }
+
+    if (!exec("COMMIT")) {
+        exec("ROLLBACK");
+        return false;
+    }
+    cout << "[SQLiteStore] Schema is at version " << sqliteMigrations().back().first << "." << endl;
+    return true;
+}
+
+vector<pair<string, string>> SQLiteStore::getKeywords() {
+    vector<pair<string, string>> keywords;
+    if (!connect()) return keywords;
+
+    sqlite3_stmt *stmt = prepare("SELECT keyword, category FROM privacy_keywords");
+    if (!stmt) return keywords;
+    StatementReset reset(stmt);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        keywords.push_back(make_pair(columnText(stmt, 0), columnText(stmt, 1)));
+    }
+    if (rc != SQLITE_DONE) {
+        fail("reading keywords");
+        keywords.clear();
+        return keywords;
+    }
+    cout << "[SQLiteStore] Keywords fetched: " << keywords.size() << endl;
+    return keywords;
+}
+
+string SQLiteStore::getKeywordsVersion() {
+    if (!connect()) return "";
+
+    // The table is local, so hashing every row is cheaper than a server checksum
+    sqlite3_stmt *stmt = prepare("SELECT id, keyword, category FROM privacy_keywords ORDER BY id");
+    if (!stmt) return "";
+    StatementReset reset(stmt);
+
+    string rows;
+    size_t count = 0;
+    long long maxId = 0;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        maxId = sqlite3_column_int64(stmt, 0);
+        rows += to_string(maxId) + '|' + columnText(stmt, 1) + '|' + columnText(stmt, 2) + '\n';
+        count++;
+    }
+    if (rc != SQLITE_DONE) {
+        fail("checking keyword version");
+        return "";
+    }
+    return to_string(count) + ":" + to_string(maxId) + ":" + contentHashHex(contentHash(rows));
+}
+
+int SQLiteStore::insertPolicy(string_view content, const string &source, const string &filename, uint64_t hash) {
+    sqlite3_stmt *stmt = prepare(
+        "INSERT INTO stored_policies (content, content_blob, content_codec, preview, source, filename, char_count, content_hash) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+    if (!stmt) return -1;
+    StatementReset reset(stmt);
+
+    EncodedContent encoded = encodeContent(content, compressionEnabled);
+    if (encoded.codec == CODEC_NONE) {
+        sqlite3_bind_text(stmt, 1, content.data(), (int)content.size(), SQLITE_STATIC);
+        sqlite3_bind_null(stmt, 2);
+    } else {
+        sqlite3_bind_null(stmt, 1);
+        sqlite3_bind_blob(stmt, 2, encoded.blob.data(), (int)encoded.blob.size(), SQLITE_STATIC);
+    }
+    sqlite3_bind_int(stmt, 3, encoded.codec);
+    sqlite3_bind_text(stmt, 4, encoded.preview.data(), (int)encoded.preview.size(), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, source.data(), (int)source.size(), SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 6, filename.data(), (int)filename.size(), SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 7, (sqlite3_int64)content.size());
+    // Stored as the signed 64-bit pattern; lookups bind it the same way
+    sqlite3_bind_int64(stmt, 8, (sqlite3_int64)(hash != 0 ? hash : contentHash(content)));
+
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        fail("storing policy");
+        return -1;
+    }
+    return (int)sqlite3_last_insert_rowid(db);
+}
+
+bool SQLiteStore::insertAnalysis(int policy_id, const string &keyword_analysis, const string &ai_summary,
+                                 const AnalysisCounts &counts) {
+    {
+        sqlite3_stmt *stmt = prepare(
+            "INSERT INTO policy_analysis (policy_id, keyword_analysis, ai_summary, counted) VALUES (?, ?, ?, ?)");
+        if (!stmt) return false;
+        StatementReset reset(stmt);
+
+        sqlite3_bind_int(stmt, 1, policy_id);
+        sqlite3_bind_text(stmt, 2, keyword_analysis.data(), (int)keyword_analysis.size(), SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, ai_summary.data(), (int)ai_summary.size(), SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 4, counts.counted ? 1 : 0);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            return fail("storing analysis");
+        }
+    }
+    if (!counts.counted) return true;
+
+    sqlite3_int64 analysis_id = sqlite3_last_insert_rowid(db);
+    for (const auto &row : counts.categories) {
+        sqlite3_stmt *stmt = prepare(
+            "INSERT INTO analysis_category_counts (analysis_id, category, occurrences) VALUES (?, ?, ?)");
+        if (!stmt) return false;
+        StatementReset reset(stmt);
+
+        sqlite3_bind_int64(stmt, 1, analysis_id);
+        sqlite3_bind_text(stmt, 2, row.category.data(), (int)row.category.size(), SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 3, (sqlite3_int64)row.occurrences);
+        if (sqlite3_step(stmt) != SQLITE_DONE) return fail("storing category counts");
+    }
+    for (const auto &row : counts.keywords) {
+        sqlite3_stmt *stmt = prepare(
+            "INSERT INTO analysis_keyword_counts (analysis_id, category, keyword, occurrences) VALUES (?, ?, ?, ?)");
+        if (!stmt) return false;
+        StatementReset reset(stmt);
+
+        sqlite3_bind_int64(stmt, 1, analysis_id);
+        sqlite3_bind_text(stmt, 2, row.category.data(), (int)row.category.size(), SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, row.keyword.data(), (int)row.keyword.size(), SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 4, (sqlite3_int64)row.occurrences);
+        if (sqlite3_step(stmt) != SQLITE_DONE) return fail("storing keyword counts");
+    }
+    return true;
+}
+
+int SQLiteStore::storePolicy(string_view content, const string& source, const string& filename, uint64_t hash) {
+    if (!connect()) return -1;
+
+    int policy_id = insertPolicy(content, source, filename, hash);
+    if (policy_id >= 0) {
+        cout << "[SQLiteStore] Policy stored successfully with ID " << policy_id << ". Characters: " << content.length() << endl;
+    }
+    return policy_id;
+}
+
+bool SQLiteStore::storePolicyBatch(const vector<PolicyWrite>& rows, vector<int>& policy_ids) {
+    if (rows.empty()) return true;
+    if (!connect() || !exec("BEGIN IMMEDIATE")) return false;
+
+    // Analysis rows point at a stored policy or at an earlier row
+    vector<int> ids;
+    size_t inserted = 0;
+    size_t analyzed = 0;
+    for (const auto &row : rows) {
+        int policy_id = row.policy_id;
+        if (row.storesPolicy()) {
+            policy_id = insertPolicy(row.text(), row.source, row.filename, row.hash);
+            inserted++;
+        } else if (row.policy_row >= 0) {
+            bool earlier = row.policy_row < (int)ids.size() && rows[row.policy_row].storesPolicy();
+            policy_id = earlier ? ids[row.policy_row] : -1;
+            if (!earlier) lastError = "Analysis row refers to a row that stores no policy";
+        }
+        if (policy_id < 0
+            || (!row.keyword_analysis.empty()
+                && !insertAnalysis(policy_id, row.keyword_analysis, row.ai_summary, row.counts))) {
+            exec("ROLLBACK");
+            return false;
+        }
+        if (!row.keyword_analysis.empty()) analyzed++;
+        ids.push_back(policy_id);
+    }
+
+    if (!exec("COMMIT")) {
+        exec("ROLLBACK");
+        return false;
+    }
+    policy_ids.insert(policy_ids.end(), ids.begin(), ids.end());
+    cout << "[SQLiteStore] Stored batch of " << inserted << " policies and " << analyzed << " analyses." << endl;
+    return true;
+}
+
+vector<PolicyRecord> SQLiteStore::getStoredPolicies() {
+    vector<PolicyRecord> policies;
+    if (!connect()) return policies;
+
+    sqlite3_stmt *stmt = prepare(
+        "SELECT id, source, filename, analysis_date, content, content_blob, content_codec, char_count "
+        "FROM stored_policies ORDER BY analysis_date DESC");
+    if (!stmt) return policies;
+    StatementReset reset(stmt);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        PolicyRecord record;
+        record.id = sqlite3_column_int(stmt, 0);
+        record.source = columnText(stmt, 1);
+        record.filename = columnText(stmt, 2);
+        record.analysis_date = columnText(stmt, 3);
+        record.char_count = (size_t)sqlite3_column_int64(stmt, 7);
+        if (!readContent(stmt, 4, record.content)) {
+            lastError = "Could not decompress policy content";
+            cerr << "[SQLiteStore] " << lastError << " (ID " << record.id << ")" << endl;
+        }
+        policies.push_back(record);
+    }
+    if (rc != SQLITE_DONE) {
+        fail("retrieving policies");
+    }
+    cout << "[SQLiteStore] Retrieved " << policies.size() << " stored policies." << endl;
+    return policies;
+}
+
+bool SQLiteStore::forEachPolicy(const function<bool(const PolicyRecord&)>& visit, int batchSize) {
+    if (!connect()) return false;
+    batchSize = max(batchSize, 1);
+
+    int afterId = 0;
+    while (true) {
+        vector<PolicyRecord> batch;
+        {
+            sqlite3_stmt *stmt = prepare(
+                "SELECT id, source, filename, analysis_date, content, content_blob, content_codec, char_count "
+                "FROM stored_policies WHERE id > ? ORDER BY id LIMIT ?");
+            if (!stmt) return false;
+            StatementReset reset(stmt);
+
+            sqlite3_bind_int(stmt, 1, afterId);
+            sqlite3_bind_int(stmt, 2, batchSize);
+            int rc;
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                PolicyRecord record;
+                record.id = sqlite3_column_int(stmt, 0);
+                record.source = columnText(stmt, 1);
+                record.filename = columnText(stmt, 2);
+                record.analysis_date = columnText(stmt, 3);
+                record.char_count = (size_t)sqlite3_column_int64(stmt, 7);
+                if (!readContent(stmt, 4, record.content)) {
+                    lastError = "Could not decompress policy content";
+                    cerr << "[SQLiteStore] " << lastError << " (ID " << record.id << ")" << endl;
+                }
+                batch.push_back(move(record));
+            }
+            if (rc != SQLITE_DONE) return fail("streaming policies");
+        }
+
+        // The statement is reset here, so visit may use this store freely
+        for (const auto &record : batch) {
+            if (!visit(record)) return true;
+        }
+        if ((int)batch.size() < batchSize) return true;
+        afterId = batch.back().id;
+    }
+}
+
+vector<PolicySummary> SQLiteStore::listPolicies(int beforeId, int limit) {
+    vector<PolicySummary> page;
+    if (!connect()) return page;
+
+    sqlite3_stmt *stmt = prepare(
+        "SELECT p.id, p.source, p.filename, p.char_count, p.analysis_date, p.preview, "
+        "(SELECT COUNT(*) FROM policy_analysis a WHERE a.policy_id = p.id) AS analysis_count "
+        "FROM stored_policies p WHERE p.id < ? ORDER BY p.id DESC LIMIT ?");
+    if (!stmt) return page;
+    StatementReset reset(stmt);
+
+    sqlite3_bind_int(stmt, 1, beforeId > 0 ? beforeId : numeric_limits<int>::max());
+    sqlite3_bind_int(stmt, 2, limit);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        PolicySummary summary;
+        summary.id = sqlite3_column_int(stmt, 0);
+        summary.source = columnText(stmt, 1);
+        summary.filename = columnText(stmt, 2);
+        summary.char_count = (size_t)sqlite3_column_int64(stmt, 3);
+        summary.analysis_date = columnText(stmt, 4);
+        summary.preview = columnText(stmt, 5);
+        summary.analysis_count = sqlite3_column_int(stmt, 6);
+        page.push_back(summary);
+    }
+    if (rc != SQLITE_DONE) {
+        fail("listing policies");
+    }
+    return page;
+}
+
+int SQLiteStore::getLatestPolicyId() {
+    if (!connect()) return -1;
+
+    sqlite3_stmt *stmt = prepare("SELECT id FROM stored_policies ORDER BY id DESC LIMIT 1");
+    if (!stmt) return -1;
+    StatementReset reset(stmt);
+
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) return sqlite3_column_int(stmt, 0);
+    if (rc != SQLITE_DONE) fail("retrieving latest policy id");
+    return -1;
+}
+
+int SQLiteStore::findPolicyByHash(uint64_t hash, size_t char_count) {
+    if (!connect()) return -1;
+
+    // char_count guards against the (unlikely) hash collision
+    sqlite3_stmt *stmt = prepare(
+        "SELECT id FROM stored_policies WHERE content_hash = ? AND char_count = ? ORDER BY id LIMIT 1");
+    if (!stmt) return -1;
+    StatementReset reset(stmt);
+
+    sqlite3_bind_int64(stmt, 1, (sqlite3_int64)hash);
+    sqlite3_bind_int64(stmt, 2, (sqlite3_int64)char_count);
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) return sqlite3_column_int(stmt, 0);
+    if (rc != SQLITE_DONE) fail("looking up policy hash");
+    return -1;
+}
+
+bool SQLiteStore::storeAnalysisResults(int policy_id, const string& keyword_analysis, const string& ai_summary,
+                                       const AnalysisCounts& counts) {
+    if (!connect()) return false;
+
+    // The analysis and its count rows are stored together or not at all
+    if (!counts.counted) {
+        if (!insertAnalysis(policy_id, keyword_analysis, ai_summary, counts)) return false;
+    } else {
+        if (!exec("BEGIN IMMEDIATE")) return false;
+        if (!insertAnalysis(policy_id, keyword_analysis, ai_summary, counts) || !exec("COMMIT")) {
+            exec("ROLLBACK");
+            return false;
+        }
+    }
+    cout << "[SQLiteStore] Analysis results stored successfully for policy ID: " << policy_id << endl;
+    return true;
+}
+
+vector<AnalysisResult> SQLiteStore::getAnalysisResults(int policy_id) {
+    vector<AnalysisResult> results;
+    if (!connect()) return results;
+
+    sqlite3_stmt *stmt = prepare(
+        "SELECT policy_id, keyword_analysis, ai_summary, analysis_date, id FROM policy_analysis "
+        "WHERE policy_id = ? ORDER BY analysis_date DESC, id DESC");
+    if (!stmt) return results;
+    StatementReset reset(stmt);
+
+    sqlite3_bind_int(stmt, 1, policy_id);
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        AnalysisResult result;
+        result.policy_id = sqlite3_column_int(stmt, 0);
+        result.keyword_analysis = columnText(stmt, 1);
+        result.ai_summary = columnText(stmt, 2);
+        result.analysis_date = columnText(stmt, 3);
+        result.id = sqlite3_column_int(stmt, 4);
+        results.push_back(result);
+    }
+    if (rc != SQLITE_DONE) {
+        fail("retrieving analysis");
+    }
+    cout << "[SQLiteStore] Retrieved " << results.size() << " analysis results for policy ID: " << policy_id << endl;
+    return results;
+}
+
+bool SQLiteStore::forEachAnalysis(int policy_id, const function<bool(const AnalysisResult&)>& visit, int batchSize) {
+    if (!connect()) return false;
+    batchSize = max(batchSize, 1);
+
+    int afterId = 0;
+    while (true) {
+        vector<AnalysisResult> batch;
+        {
+            // One statement per case, so a single policy's walk can use the
+            // policy_id index instead of an OR the planner cannot index
+            sqlite3_stmt *stmt = prepare(policy_id < 0
+                ? "SELECT policy_id, keyword_analysis, ai_summary, analysis_date, id FROM policy_analysis "
+                  "WHERE id > ? ORDER BY id LIMIT ?"
+                : "SELECT policy_id, keyword_analysis, ai_summary, analysis_date, id FROM policy_analysis "
+                  "WHERE policy_id = ? AND id > ? ORDER BY id LIMIT ?");
+            if (!stmt) return false;
+            StatementReset reset(stmt);
+
+            int param = 1;
+            if (policy_id >= 0) sqlite3_bind_int(stmt, param++, policy_id);
+            sqlite3_bind_int(stmt, param++, afterId);
+            sqlite3_bind_int(stmt, param, batchSize);
+            int rc;
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                AnalysisResult result;
+                result.policy_id = sqlite3_column_int(stmt, 0);
+                result.keyword_analysis = columnText(stmt, 1);
+                result.ai_summary = columnText(stmt, 2);
+                result.analysis_date = columnText(stmt, 3);
+                result.id = sqlite3_column_int(stmt, 4);
+                batch.push_back(move(result));
+            }
+            if (rc != SQLITE_DONE) return fail("streaming analyses");
+        }
+
+        for (const auto &result : batch) {
+            if (!visit(result)) return true;
+        }
+        if ((int)batch.size() < batchSize) return true;
+        afterId = batch.back().id;
+    }
+}
+
+bool SQLiteStore::getLatestAnalysis(int policy_id, AnalysisResult& result) {
+    if (!connect()) return false;
+
+    sqlite3_stmt *stmt = prepare(
+        "SELECT policy_id, keyword_analysis, ai_summary, analysis_date, id FROM policy_analysis "
+        "WHERE policy_id = ? ORDER BY analysis_date DESC, id DESC LIMIT 1");
+    if (!stmt) return false;
+    StatementReset reset(stmt);
+
+    sqlite3_bind_int(stmt, 1, policy_id);
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        result.policy_id = sqlite3_column_int(stmt, 0);
+        result.keyword_analysis = columnText(stmt, 1);
+        result.ai_summary = columnText(stmt, 2);
+        result.analysis_date = columnText(stmt, 3);
+        result.id = sqlite3_column_int(stmt, 4);
+        return true;
+    }
+    if (rc != SQLITE_DONE) fail("retrieving latest analysis");
+    return false;
+}
+
+bool SQLiteStore::getAnalysisCounts(int analysis_id, AnalysisCounts& counts) {
+    counts = AnalysisCounts();
+    if (!connect()) return false;
+
+    {
+        sqlite3_stmt *stmt = prepare("SELECT counted FROM policy_analysis WHERE id = ?");
+        if (!stmt) return false;
+        StatementReset reset(stmt);
+
+        sqlite3_bind_int(stmt, 1, analysis_id);
+        int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_DONE) return true;
+        if (rc != SQLITE_ROW) return fail("reading analysis counts");
+        if (sqlite3_column_int(stmt, 0) == 0) return true;
+    }
+
+    {
+        sqlite3_stmt *stmt = prepare(
+            "SELECT category, occurrences FROM analysis_category_counts WHERE analysis_id = ?");
+        if (!stmt) return false;
+        StatementReset reset(stmt);
+
+        sqlite3_bind_int(stmt, 1, analysis_id);
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            counts.categories.push_back({columnText(stmt, 0), (size_t)sqlite3_column_int64(stmt, 1)});
+        }
+        if (rc != SQLITE_DONE) return fail("reading category counts");
+    }
+    {
+        sqlite3_stmt *stmt = prepare(
+            "SELECT category, keyword, occurrences FROM analysis_keyword_counts WHERE analysis_id = ?");
+        if (!stmt) return false;
+        StatementReset reset(stmt);
+
+        sqlite3_bind_int(stmt, 1, analysis_id);
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            counts.keywords.push_back({columnText(stmt, 0), columnText(stmt, 1), (size_t)sqlite3_column_int64(stmt, 2)});
+        }
+        if (rc != SQLITE_DONE) return fail("reading keyword counts");
+    }
+    counts.counted = true;
+    return true;
+}
+
+vector<CoverageStat> SQLiteStore::getCoverage(bool byKeyword) {
+    vector<CoverageStat> stats;
+    if (!connect()) return stats;
+
+    // Same query as the MySQL backend; idx_policy_counted covers the inner one
+    string latest = "(SELECT MAX(id) AS id FROM policy_analysis WHERE counted = 1 GROUP BY policy_id) latest ";
+    sqlite3_stmt *stmt = prepare(byKeyword
+        ? "SELECT c.category, c.keyword, COUNT(*) AS policies, SUM(c.occurrences) AS occurrences FROM "
+          + latest + "JOIN analysis_keyword_counts c ON c.analysis_id = latest.id "
+          "GROUP BY c.category, c.keyword ORDER BY policies DESC, occurrences DESC, c.category, c.keyword"
+        : "SELECT c.category, '' AS keyword, COUNT(*) AS policies, SUM(c.occurrences) AS occurrences FROM "
+          + latest + "JOIN analysis_category_counts c ON c.analysis_id = latest.id "
+          "GROUP BY c.category ORDER BY policies DESC, occurrences DESC, c.category");
+    if (!stmt) return stats;
+    StatementReset reset(stmt);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        CoverageStat stat;
+        stat.category = columnText(stmt, 0);
+        stat.keyword = columnText(stmt, 1);
+        stat.policies = sqlite3_column_int(stmt, 2);
+        stat.occurrences = (uint64_t)sqlite3_column_int64(stmt, 3);
+        stats.push_back(stat);
+    }
+    if (rc != SQLITE_DONE) {
+        fail("computing coverage");
+    }
+    return stats;
+}
+
+void SQLiteStore::setCompression(bool enabled) {
+    compressionEnabled = enabled;
+}
+
+void SQLiteStore::setMultiRowInserts(bool) {
+}
+
+string SQLiteStore::getLastError() const {
+    return lastError;
+}
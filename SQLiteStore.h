@@ -0,0 +1,85 @@
+// SQLiteStore.h
+#ifndef SQLITESTORE_H
+#define SQLITESTORE_H
+
+#include "PolicyStore.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+
+using namespace std;
+
+// Embedded PolicyStore on a local SQLite file, or on an in-memory database
+// shared by every store in the process (path ":memory:"). No network round
+// trips, so it suits single-node use, tests, and benchmarks that should
+// measure analysis rather than the database. Same tables and columns as
+// the MySQL backend; a new database starts with the sample keyword set.
+class SQLiteStore : public PolicyStore {
+private:
+    string path;
+    sqlite3 *db;
+    map<string, sqlite3_stmt *> statements; // prepared once per connection
+    string lastError;
+    bool compressionEnabled;
+
+    // Cached statement for sql with its bindings cleared; nullptr on error
+    sqlite3_stmt *prepare(const string &sql);
+
+    // Run statements that return no rows
+    bool exec(const string &sql);
+
+    // Record the connection's current error under context; always false
+    bool fail(const string &context);
+
+    // One stored_policies row; -1 on failure
+    int insertPolicy(string_view content, const string &source, const string &filename, uint64_t hash);
+    // One policy_analysis row and, if counted, its count rows
+    bool insertAnalysis(int policy_id, const string &keyword_analysis, const string &ai_summary,
+                        const AnalysisCounts &counts);
+
+public:
+    explicit SQLiteStore(const string &file);
+    ~SQLiteStore() override;
+
+    SQLiteStore(const SQLiteStore&) = delete;
+    SQLiteStore& operator=(const SQLiteStore&) = delete;
+
+    bool connect() override;
+    void close() override;
+    vector<pair<string, string>> getKeywords() override;
+
+    // Row count, max id and hash of privacy_keywords
+    string getKeywordsVersion() override;
+
+    bool migrateSchema() override;
+
+    int storePolicy(string_view content, const string& source, const string& filename = "", uint64_t hash = 0) override;
+
+    // Single-row inserts inside one transaction; with no server round trip
+    // that is as fast as a multi-row statement
+    bool storePolicyBatch(const vector<PolicyWrite>& rows, vector<int>& policy_ids) override;
+
+    vector<PolicyRecord> getStoredPolicies() override;
+    bool forEachPolicy(const function<bool(const PolicyRecord&)>& visit, int batchSize = 100) override;
+    vector<PolicySummary> listPolicies(int beforeId, int limit) override;
+    int getLatestPolicyId() override;
+    int findPolicyByHash(uint64_t hash, size_t char_count) override;
+
+    bool storeAnalysisResults(int policy_id, const string& keyword_analysis, const string& ai_summary = "",
+                              const AnalysisCounts& counts = AnalysisCounts()) override;
+    vector<AnalysisResult> getAnalysisResults(int policy_id) override;
+    bool forEachAnalysis(int policy_id, const function<bool(const AnalysisResult&)>& visit, int batchSize = 100) override;
+    bool getLatestAnalysis(int policy_id, AnalysisResult& result) override;
+    bool getAnalysisCounts(int analysis_id, AnalysisCounts& counts) override;
+    vector<CoverageStat> getCoverage(bool byKeyword = false) override;
+
+    void setCompression(bool enabled) override;
+
+    // No effect: rows are always inserted one prepared statement at a time,
+    // which costs no round trips in-process
+    void setMultiRowInserts(bool enabled) override;
+    string getLastError() const override;
+};
+
+#endif
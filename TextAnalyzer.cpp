@@ -3,7 +3,12 @@
 #include <fstream>
 #include <iostream>
 
-TextAnalyzer::TextAnalyzer() {
+// Token budget for the key sentences sent to the LLM in place of the full text
+static const size_t SUMMARY_EXCERPT_TOKENS = 384;
+
+TextAnalyzer::TextAnalyzer(const string &storeSpec)
+    : store(openStore(storeSpec)), quiet(false), summaryTokenLimit(256), matchesCurrent(false), currentHash(0), currentPolicyId(-1), analysisReused(false),
+      persistence(storeSpec), currentPolicyTicket(-1) {
     cout << "[TextAnalyzer] Ready to analyze privacy policy text.\n";
     
     // Check if LLM server is available
@@ -18,11 +23,44 @@ TextAnalyzer::TextAnalyzer() {
     currentFilename = "";
 }
 
+string_view TextAnalyzer::currentText() const {
+    if (mappedFile) {
+        return mappedFile->view();
+    }
+    return policyText ? string_view(*policyText) : string_view();
+}
+
+shared_ptr<const void> TextAnalyzer::currentTextOwner() const {
+    if (mappedFile) {
+        return mappedFile;
+    }
+    return policyText;
+}
+
+void TextAnalyzer::onTextLoaded() {
+    string_view text = currentText();
+    currentHash = text.empty() ? 0 : contentHash(text);
+    currentPolicyId = -1;
+    currentPolicyTicket = -1;
+    analysisReused = false;
+    matchesCurrent = false;
+    storedSummary.clear();
+}
+
+bool TextAnalyzer::findStoredCopy() {
+    if (currentPolicyId < 0 && currentHash != 0) {
+        currentPolicyId = store->findPolicyByHash(currentHash, currentText().size());
+    }
+    return currentPolicyId >= 0;
+}
+
 void TextAnalyzer::loadText(const string &text) {
-    policyText = text;
+    mappedFile.reset();
+    policyText = make_shared<const string>(text);
     currentSource = "manual";
     currentFilename = "";
-    cout << "[TextAnalyzer] Text loaded (" << policyText.size() << " characters).\n";
+    onTextLoaded();
+    cout << "[TextAnalyzer] Text loaded (" << policyText->size() << " characters).\n";
 }
 
 bool TextAnalyzer::loadFromFile(const string &filename) {
@@ -34,39 +72,128 @@ bool TextAnalyzer::loadFromFile(const string &filename) {
 
     stringstream buffer;
     buffer << file.rdbuf();
-    policyText = buffer.str();
+    mappedFile.reset();
+    policyText = make_shared<const string>(buffer.str());
     currentSource = "file";
     currentFilename = filename;
+    onTextLoaded();
 
     cout << "[TextAnalyzer] File loaded successfully: " << filename << endl;
     return true;
 }
 
+bool TextAnalyzer::loadFromFileMapped(const string &filename) {
+    // A fresh mapping each time; the previous one may still be queued
+    shared_ptr<MappedFile> file = make_shared<MappedFile>();
+    if (!file->open(filename)) {
+        cerr << "[TextAnalyzer] Could not map file: " << filename << endl;
+        return false;
+    }
+
+    mappedFile = file;
+    policyText.reset();
+    currentSource = "file";
+    currentFilename = filename;
+    onTextLoaded();
+
+    cout << "[TextAnalyzer] File mapped successfully: " << filename
+         << " (" << mappedFile->view().size() << " characters)" << endl;
+    return true;
+}
+
 void TextAnalyzer::analyze() {
-    if (policyText.empty()) {
+    string_view text = currentText();
+    if (text.empty()) {
         cerr << "[TextAnalyzer] No text loaded. Please load text first.\n";
         return;
     }
 
-    if (!matcher.loadKeywords()) {
+    // An identical policy that was already analyzed needs no new pass
+    if (findStoredCopy()) {
+        AnalysisResult previous;
+        // The counts come along, so a summary stored later gets the same rows
+        if (store->getLatestAnalysis(currentPolicyId, previous)
+            && store->getAnalysisCounts(previous.id, lastKeywordCounts)) {
+            lastKeywordAnalysis = previous.keyword_analysis;
+            matchesCurrent = false;
+            storedSummary = previous.ai_summary;
+            analysisReused = true;
+            if (!quiet) {
+                cout << "\n Identical policy already analyzed (ID " << currentPolicyId
+                     << ", " << previous.analysis_date << "). Reusing stored analysis:\n";
+                cout << lastKeywordAnalysis;
+            }
+            return;
+        }
+    }
+    analysisReused = false;
+    storedSummary.clear();
+
+    if (!matcher.loadKeywords(*store)) {
         cerr << "[TextAnalyzer] Could not load keywords from DB.\n";
         return;
     }
 
-    cout << "\n Starting keyword analysis...\n";
-    matcher.findMatches(policyText);
-    matcher.showSummary();
+    if (!quiet) cout << "\n Starting keyword analysis...\n";
+    matcher.findMatches(text);
+    matchesCurrent = true;
+    if (!quiet) matcher.showSummary();
     
     // Store the detailed keyword analysis for LLM
     lastKeywordAnalysis = matcher.getKeywordAnalysis();
+    lastKeywordCounts = matcher.analysisCounts(matcher.getLastResult());
     
-    cout << " Analysis completed! Keyword data stored for AI summary.\n";
+    if (!quiet) cout << " Analysis completed! Keyword data stored for AI summary.\n";
+}
+
+bool TextAnalyzer::analyzeFileStreaming(const string &filename) {
+    ifstream file(filename, ios::binary);
+    if (!file.is_open()) {
+        cerr << "[TextAnalyzer] Could not open file: " << filename << endl;
+        return false;
+    }
+
+    if (!matcher.loadKeywords(*store)) {
+        cerr << "[TextAnalyzer] Could not load keywords from DB.\n";
+        return false;
+    }
+
+    // The previously loaded text no longer matches the analysis
+    mappedFile.reset();
+    policyText.reset();
+    currentSource = "file";
+    currentFilename = filename;
+    onTextLoaded();
+
+    if (!quiet) cout << "\n Starting streaming keyword analysis of " << filename << "...\n";
+    if (!matcher.findMatchesInStream(file)) {
+        cerr << "[TextAnalyzer] Failed while reading file: " << filename << endl;
+        return false;
+    }
+    if (!quiet) matcher.showSummary();
+
+    lastKeywordAnalysis = matcher.getKeywordAnalysis();
+    lastKeywordCounts = matcher.analysisCounts(matcher.getLastResult());
+
+    if (!quiet) cout << " Streaming analysis completed!\n";
+    return true;
 }
 
-string TextAnalyzer::generateSummary() {
-    if (policyText.empty()) {
+string TextAnalyzer::generateSummary(const TokenCallback& onToken) {
+    string_view text = currentText();
+    if (text.empty()) {
         return "Error: No privacy policy text loaded. Please load text first.";
     }
+
+    auto emit = [&](const string& piece) {
+        if (onToken) onToken(piece);
+        return piece;
+    };
+
+    if (analysisReused && !storedSummary.empty()) {
+        cout << " Reusing the AI summary stored for identical policy ID " << currentPolicyId << ".\n";
+        return emit(storedSummary);
+    }
     
     cout << " Generating AI-powered summary based on keyword analysis...\n";
     cout << "This may take 10-20 seconds...\n";
@@ -82,11 +209,44 @@ string TextAnalyzer::generateSummary() {
         summary << "Using keyword analysis instead:\n";
         summary << "------------------------------------\n";
         summary << lastKeywordAnalysis;
-        return summary.str();
+        return emit(summary.str());
+    }
+
+    string header = "\n AI-Powered Privacy Policy Summary (Based on Keyword Analysis)\n"
+                    "==============================================================\n";
+    string footer = "\n==============================================================\n"
+                    "\nNote: This AI analysis is based on detected privacy-related keywords and should be verified by legal experts.\n";
+
+    // The header goes out just before the first token, so nothing is shown
+    // for a request that fails outright
+    bool streamed = false;
+    TokenCallback relay;
+    if (onToken) {
+        relay = [&](const string& token) {
+            if (!streamed) {
+                streamed = true;
+                onToken(header);
+            }
+            return onToken(token);
+        };
     }
     
+    // Send the sentences that carry keyword hits rather than the whole
+    // policy; without offsets for this text the full text goes instead
+    string_view prompt = text;
+    Excerpt excerpt;
+    if (matchesCurrent) {
+        excerpt = ExcerptSelector(SUMMARY_EXCERPT_TOKENS).select(text, matcher.getLastResult());
+        if (!excerpt.text.empty()) {
+            prompt = excerpt.text;
+            cout << " Using " << excerpt.sentences << " of " << excerpt.candidates
+                 << " key sentences (~" << excerpt.estimatedTokens << " tokens, "
+                 << excerpt.categoriesCovered << " categories).\n";
+        }
+    }
+
     // Generate summary using LLM with keyword analysis
-    string llmSummary = llmManager.generateSummary(policyText, lastKeywordAnalysis);
+    string llmSummary = llmManager.generateSummary(prompt, lastKeywordAnalysis, relay, summaryTokenLimit);
     
     if (llmSummary.find("Error:") == 0) {
         cout << "[LLM] Generation failed: " << llmSummary << endl;
@@ -97,20 +257,18 @@ string TextAnalyzer::generateSummary() {
         summary << "Using keyword analysis instead:\n";
         summary << "------------------------------------\n";
         summary << lastKeywordAnalysis;
-        return summary.str();
+        if (streamed) emit("\n");
+        return emit(summary.str());
     }
-    
-    stringstream summary;
-    summary << "\n AI-Powered Privacy Policy Summary (Based on Keyword Analysis)\n";
-    summary << "==============================================================\n";
-    summary << llmSummary;
-    summary << "\n==============================================================\n";
-    summary << "\nNote: This AI analysis is based on detected privacy-related keywords and should be verified by legal experts.\n";
-    return summary.str();
+
+    if (!streamed) emit(header + llmSummary);
+    emit(footer);
+    return header + llmSummary + footer;
 }
 
 bool TextAnalyzer::storeCurrentPolicy() {
-    if (policyText.empty()) {
+    string_view text = currentText();
+    if (text.empty()) {
         cerr << "[TextAnalyzer] No policy text to store.\n";
         return false;
     }
@@ -120,18 +278,49 @@ bool TextAnalyzer::storeCurrentPolicy() {
         return false;
     }
     
-    // Use the DatabaseManager from matcher to store the policy
-    bool success = matcher.storePolicy(policyText, currentSource, currentFilename);
-    if (success) {
-        cout << "[TextAnalyzer] Policy stored in database successfully.\n";
-    } else {
-        cerr << "[TextAnalyzer] Failed to store policy in database.\n";
+    if (currentPolicyTicket >= 0) {
+        cout << "[TextAnalyzer] This policy is already queued for storage.\n";
+        return true;
     }
-    return success;
+
+    // Already matched to a stored copy by analyze()
+    if (currentPolicyId >= 0) {
+        cout << "[TextAnalyzer] Identical policy already stored as ID " << currentPolicyId << ", skipping insert.\n";
+        return true;
+    }
+
+    // The writer thread inserts it, or links an identical stored copy
+    // instead; the id is known once the queue flushes. The row shares the
+    // loaded text rather than copying it.
+    PolicyWrite row;
+    row.contentView = text;
+    row.contentOwner = currentTextOwner();
+    row.source = currentSource;
+    row.filename = currentFilename;
+    row.hash = currentHash;
+    row.reuseStored = true;
+    currentPolicyTicket = persistence.enqueuePolicy(move(row));
+    if (currentPolicyTicket < 0) {
+        cerr << "[TextAnalyzer] Failed to queue policy for storage.\n";
+        return false;
+    }
+
+    cout << "[TextAnalyzer] Policy queued for storage in database.\n";
+    return true;
 }
 
 vector<PolicyRecord> TextAnalyzer::getStoredPolicies() {
-    return matcher.getStoredPolicies();
+    flushPending();
+    return store->getStoredPolicies();
+}
+
+vector<PolicySummary> TextAnalyzer::listStoredPolicies(int beforeId, int limit) {
+    flushPending();
+    return store->listPolicies(beforeId, limit);
+}
+
+bool TextAnalyzer::flushPending() {
+    return persistence.flush();
 }
 
 bool TextAnalyzer::storeAnalysisResults(const string& ai_summary) {
@@ -140,36 +329,65 @@ bool TextAnalyzer::storeAnalysisResults(const string& ai_summary) {
         return false;
     }
     
-    // Get the last stored policy ID
-    vector<PolicyRecord> policies = getStoredPolicies();
-    if (policies.empty()) {
-        cerr << "[TextAnalyzer] No stored policies found. Please store the policy first.\n";
+    // The analysis came from this policy's stored row; don't duplicate it
+    if (analysisReused && (ai_summary.empty() || ai_summary == storedSummary)) {
+        cout << "[TextAnalyzer] Analysis for policy ID " << currentPolicyId << " is already stored.\n";
+        return true;
+    }
+
+    // Linked to the queued policy by ticket, so no need to wait for its id
+    if (currentPolicyTicket >= 0) {
+        bool queued = persistence.enqueueAnalysisForTicket(currentPolicyTicket, lastKeywordAnalysis, ai_summary,
+                                                           lastKeywordCounts);
+        if (queued) {
+            cout << "[TextAnalyzer] Analysis results queued for the stored policy.\n";
+        } else {
+            cerr << "[TextAnalyzer] Failed to queue analysis results.\n";
+        }
+        return queued;
+    }
+
+    int policy_id = getLastStoredPolicyId();
+    if (policy_id < 0) {
+        cerr << "[TextAnalyzer] The current policy is not stored. Please store the policy first.\n";
         return false;
     }
     
-    int latest_policy_id = policies[0].id; // Get the latest policy ID
-    
-    bool success = matcher.storeAnalysisResults(latest_policy_id, lastKeywordAnalysis, ai_summary);
+    bool success = persistence.enqueueAnalysis(policy_id, lastKeywordAnalysis, ai_summary, lastKeywordCounts);
     if (success) {
-        cout << "[TextAnalyzer] Analysis results stored successfully for policy ID: " << latest_policy_id << endl;
+        cout << "[TextAnalyzer] Analysis results queued for policy ID: " << policy_id << endl;
     } else {
-        cerr << "[TextAnalyzer] Failed to store analysis results.\n";
+        cerr << "[TextAnalyzer] Failed to queue analysis results.\n";
     }
     return success;
 }
 
 vector<AnalysisResult> TextAnalyzer::getAnalysisHistory(int policy_id) {
-    return matcher.getAnalysisResults(policy_id);
+    flushPending();
+    return store->getAnalysisResults(policy_id);
 }
 
 int TextAnalyzer::getLastStoredPolicyId() {
-    vector<PolicyRecord> policies = getStoredPolicies();
-    if (policies.empty()) {
-        return -1;
+    // Known when the current text was stored or matched a stored copy
+    if (currentPolicyId < 0 && currentPolicyTicket >= 0) {
+        flushPending();
+        currentPolicyId = persistence.policyId(currentPolicyTicket);
     }
-    return policies[0].id; // Return the latest policy ID
+    // Never guess: the newest row may be a different policy
+    return currentPolicyId;
+}
+
+void TextAnalyzer::setSummaryTokenLimit(size_t tokens) {
+    summaryTokenLimit = tokens;
+}
+
+void TextAnalyzer::setQuiet(bool enabled) {
+    quiet = enabled;
+    matcher.setQuiet(enabled);
 }
 
 TextAnalyzer::~TextAnalyzer() {
+    // Nothing queued may be lost on exit
+    persistence.shutdown();
     cout << "[TextAnalyzer] Analysis completed and resources cleared.\n";
 }
\ No newline at end of file
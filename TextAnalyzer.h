@@ -4,6 +4,10 @@
 
 #include "KeywordMatcher.h"
 #include "LLMManager.h"
+#include "MappedFile.h"
+#include "ContentHash.h"
+#include "PersistenceQueue.h"
+#include "ExcerptSelector.h"
 #include <sstream>
 #include <iostream>
 
@@ -11,15 +15,46 @@ using namespace std;
 
 class TextAnalyzer {
 protected:
-    string policyText;
+    // The loaded text lives in one of these; queued stores share ownership,
+    // so loading another policy never pulls the text from under them
+    shared_ptr<const string> policyText;
+    shared_ptr<const MappedFile> mappedFile;
     KeywordMatcher matcher;
+    unique_ptr<PolicyStore> store; // keywords, lookups and listings (see openStore)
     LLMManager llmManager;
     string lastKeywordAnalysis;
+    AnalysisCounts lastKeywordCounts; // structured form; a reused analysis brings its stored counts
     string currentSource; // Track where the current text came from
     string currentFilename; // Track filename if loaded from file
+    bool quiet; // no per-hit highlighting or summaries on the console
+    size_t summaryTokenLimit;
+    bool matchesCurrent;    // matcher's last result has hit offsets for the loaded text
+
+    // Deduplication against stored_policies
+    uint64_t currentHash;   // contentHash of the loaded text, 0 if none
+    int currentPolicyId;    // stored copy of the loaded text, -1 if unknown
+    bool analysisReused;    // lastKeywordAnalysis came from the database
+    string storedSummary;   // AI summary stored with the reused analysis
+
+    // Stores run behind on this queue so analysis never waits for MySQL
+    PersistenceQueue persistence;
+    int64_t currentPolicyTicket; // queued copy of the loaded text, -1 if none
+
+    // The loaded policy, whether it lives in policyText or in mappedFile
+    string_view currentText() const;
+
+    // Whichever of policyText and mappedFile holds currentText()
+    shared_ptr<const void> currentTextOwner() const;
+
+    // Reset per-document state and hash the newly loaded text
+    void onTextLoaded();
+
+    // Look up a stored policy with identical content; true if one exists
+    bool findStoredCopy();
 
 public:
-    TextAnalyzer();
+    // storeSpec selects the storage backend; it must name a valid one
+    explicit TextAnalyzer(const string &storeSpec = "");
 
     // Load text directly
     virtual void loadText(const string &text);
@@ -27,31 +62,63 @@ public:
     // Or load from file
     virtual bool loadFromFile(const string &filename);
 
+    // Or map the file into memory; analysis, summary and storage then read
+    // the mapping directly instead of a heap copy
+    virtual bool loadFromFileMapped(const string &filename);
+
     // Analyze the text
     virtual void analyze();
 
+    // Keyword analysis of a file read in fixed-size buffers; the text is
+    // never held in memory, so it cannot be stored or summarized afterwards
+    virtual bool analyzeFileStreaming(const string &filename);
+
+    // Files larger than this are streamed by the menu instead of loaded
+    static const uintmax_t STREAMING_THRESHOLD = 256ull * 1024 * 1024;
+
     // TextAnalyzer.h - Add to the public section
-    // Store analysis results for current policy
+    // Store analysis results for current policy (queued, written in the background)
     virtual bool storeAnalysisResults(const string& ai_summary = "");
     
     // Get analysis history for a specific policy
     virtual vector<AnalysisResult> getAnalysisHistory(int policy_id);
     
-    // Get the last stored policy ID (for linking analysis)
+    // Id of the current policy's stored row, or -1 if it has not been
+    // stored (for linking analysis)
     virtual int getLastStoredPolicyId();
 
-    // Generate a short summary based on keyword stats
-    virtual string generateSummary();
+    // Generate a short summary based on keyword stats. With onToken, every
+    // part of the summary is also handed to it as soon as it is known (the
+    // model's words as they stream in), so a caller can print it live.
+    virtual string generateSummary(const TokenCallback& onToken = nullptr);
+
+    // Most tokens the model may generate for one summary (0 = no limit)
+    void setSummaryTokenLimit(size_t tokens);
 
-    // Store current policy in database
+    // Store current policy in database (queued, written in the background)
     virtual bool storeCurrentPolicy();
 
+    // Wait until every queued store has reached the database; false if
+    // any write failed
+    bool flushPending();
+
     // Get stored policies from database
     virtual vector<PolicyRecord> getStoredPolicies();
 
+    // One page of stored policy metadata (see PolicyStore::listPolicies)
+    virtual vector<PolicySummary> listStoredPolicies(int beforeId, int limit);
+
+    // Batch-friendly mode: analysis prints no highlights or summaries
+    void setQuiet(bool enabled);
+
     // Get the keyword matcher for access to analysis
     KeywordMatcher& getMatcher() { return matcher; }
 
+    PolicyStore& getStore() { return *store; }
+
+    // For cancelling a summary in progress
+    LLMManager& getLLM() { return llmManager; }
+
     virtual ~TextAnalyzer();
 };
 
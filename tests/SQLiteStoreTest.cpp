@@ -0,0 +1,180 @@
+// SQLiteStoreTest.cpp
+// Runs the PolicyStore contract against the in-memory SQLite backend, so it
+// needs no server. Build and run from the repository root:
+//   g++ -std=c++17 -I. tests/SQLiteStoreTest.cpp SQLiteStore.cpp ContentHash.cpp ContentCodec.cpp -o sqlite_store_test -lsqlite3 -lz
+//   ./sqlite_store_test
+#include "SQLiteStore.h"
+#include "ContentHash.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #condition << endl; \
+            failures++;                                                           \
+        }                                                                         \
+    } while (0)
+
+static AnalysisCounts sampleCounts(size_t collect, size_t share) {
+    AnalysisCounts counts;
+    counts.counted = true;
+    counts.categories = {{"Data Collection", collect}, {"Data Sharing", share}};
+    counts.keywords = {{"Data Collection", "collect", collect}, {"Data Sharing", "share", share}};
+    return counts;
+}
+
+static void testSchemaAndKeywords(PolicyStore &store) {
+    CHECK(store.migrateSchema());
+    CHECK(store.migrateSchema()); // already current
+    CHECK(store.getKeywords().size() == 5);
+    CHECK(!store.getKeywordsVersion().empty());
+}
+
+static void testStoreAndFind(PolicyStore &store) {
+    string small = "We collect your email address.";
+    string large;
+    for (int i = 0; i < 200; i++) large += "We share usage data with a third party. ";
+
+    int smallId = store.storePolicy(small, "manual");
+    int largeId = store.storePolicy(large, "file", "large.txt"); // compressed
+    CHECK(smallId > 0);
+    CHECK(largeId > smallId);
+    CHECK(store.findPolicyByHash(contentHash(small), small.size()) == smallId);
+    CHECK(store.findPolicyByHash(contentHash(large), large.size()) == largeId);
+    CHECK(store.findPolicyByHash(contentHash(large), large.size() + 1) < 0);
+
+    bool sawLarge = false;
+    for (const PolicyRecord &record : store.getStoredPolicies()) {
+        if (record.id == largeId) {
+            CHECK(record.content == large);
+            CHECK(record.char_count == large.size());
+            sawLarge = true;
+        }
+    }
+    CHECK(sawLarge);
+}
+
+static void testBatch(PolicyStore &store) {
+    int existing = store.storePolicy("An existing policy we share.", "manual");
+
+    vector<PolicyWrite> rows(3);
+    rows[0].content = "Batch policy one: we collect and share.";
+    rows[0].source = "file";
+    rows[0].keyword_analysis = "analysis one";
+    rows[0].counts = sampleCounts(1, 1);
+    rows[1].policy_row = 0; // a second analysis of row 0's policy
+    rows[1].keyword_analysis = "analysis one, again";
+    rows[2].policy_id = existing;
+    rows[2].keyword_analysis = "analysis of the existing policy";
+    rows[2].counts = sampleCounts(0, 1);
+
+    vector<int> ids;
+    CHECK(store.storePolicyBatch(rows, ids));
+    CHECK(ids.size() == 3);
+    if (ids.size() == 3) {
+        CHECK(ids[0] > existing);
+        CHECK(ids[1] == ids[0]);
+        CHECK(ids[2] == existing);
+        CHECK(store.getAnalysisResults(ids[0]).size() == 2);
+
+        AnalysisResult latest;
+        CHECK(store.getLatestAnalysis(existing, latest));
+        CHECK(latest.keyword_analysis == "analysis of the existing policy");
+
+        // Counts come back with the analysis they were stored with
+        AnalysisCounts counts;
+        CHECK(store.getAnalysisCounts(latest.id, counts));
+        CHECK(counts.counted && counts.categories.size() == 2 && counts.keywords.size() == 2);
+        for (const CategoryCount &row : counts.categories) {
+            CHECK(row.occurrences == (row.category == "Data Sharing" ? 1u : 0u));
+        }
+
+        CHECK(store.getLatestAnalysis(ids[1], latest));
+        CHECK(latest.keyword_analysis == "analysis one, again");
+        CHECK(store.getAnalysisCounts(latest.id, counts));
+        CHECK(!counts.counted && counts.categories.empty());
+    }
+
+    // Only the two counted analyses show up in coverage
+    int sharing = 0;
+    for (const CoverageStat &stat : store.getCoverage()) {
+        if (stat.category == "Data Sharing") sharing = stat.policies;
+    }
+    CHECK(sharing == 2);
+
+    // An analysis may only point at an earlier row that stores a policy
+    vector<PolicyWrite> bad(1);
+    bad[0].policy_row = 0;
+    bad[0].keyword_analysis = "points at itself";
+    vector<int> none;
+    CHECK(!store.storePolicyBatch(bad, none));
+}
+
+static void testStreaming(PolicyStore &store) {
+    vector<PolicyRecord> all = store.getStoredPolicies();
+    int seen = 0;
+    int lastId = 0;
+    bool ordered = true;
+    CHECK(store.forEachPolicy([&](const PolicyRecord &record) {
+        ordered = ordered && record.id > lastId;
+        lastId = record.id;
+        seen++;
+        return true;
+    }, 2));
+    CHECK(ordered);
+    CHECK(seen == (int)all.size());
+
+    int visited = 0;
+    store.forEachPolicy([&](const PolicyRecord &) { return ++visited < 2; }, 1);
+    CHECK(visited == 2);
+
+    // A batch size below 1 still walks every row
+    seen = 0;
+    CHECK(store.forEachPolicy([&](const PolicyRecord &) { seen++; return true; }, 0));
+    CHECK(seen == (int)all.size());
+
+    // One policy's analyses, and then every analysis
+    int policyId = 0;
+    size_t expected = 0;
+    for (const PolicyRecord &record : all) {
+        size_t count = store.getAnalysisResults(record.id).size();
+        if (count > expected) {
+            policyId = record.id;
+            expected = count;
+        }
+    }
+    int analyses = 0;
+    bool samePolicy = true;
+    CHECK(store.forEachAnalysis(policyId, [&](const AnalysisResult &result) {
+        samePolicy = samePolicy && result.policy_id == policyId;
+        analyses++;
+        return true;
+    }, 1));
+    CHECK(samePolicy);
+    CHECK(expected == 2 && analyses == (int)expected);
+
+    int everyAnalysis = 0;
+    CHECK(store.forEachAnalysis(-1, [&](const AnalysisResult &) { everyAnalysis++; return true; }, 0));
+    CHECK(everyAnalysis > analyses);
+}
+
+int main() {
+    SQLiteStore store(":memory:");
+    CHECK(store.connect());
+
+    testSchemaAndKeywords(store);
+    testStoreAndFind(store);
+    testBatch(store);
+    testStreaming(store);
+
+    if (failures > 0) {
+        cerr << failures << " check(s) failed" << endl;
+        return 1;
+    }
+    cout << "All SQLiteStore checks passed" << endl;
+    return 0;
+}